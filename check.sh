@@ -0,0 +1,78 @@
+#!/bin/sh
+# Builds and runs one experiment in each engine and run mode configuration
+# (the default build also tests compiled kernels), failing on a build
+# error, a crash or a failed test, and runs the default build at sizes
+# with kernels of their own and without. Then checks that fixed-seed runs
+# with one worker repeat exactly in each run mode.
+set -e
+CC=${CC:-gcc}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+build() {
+  $CC -Wall -DSFMT_MEXP=19937 -O3 "$@" -o "$dir/combinational" combinational.c mt/SFMT.c -ldl -lpthread
+}
+run_checked() {
+  (cd "$dir" && ./combinational --experiments=1 "$@" > run.log)
+  if grep -q FAILED "$dir/run.log"; then
+    grep FAILED "$dir/run.log"
+    exit 1
+  fi
+  tail -n 2 "$dir/run.log"
+}
+for config in \
+    "-DCODEGEN_TESTS=1" \
+    "-DBITSLICED=0 -DSIMD=0" \
+    "-DBITSLICED=0 -DSIMD=0 -DSCC_CONDENSED=0" \
+    "-DBITSLICED=0 -DSIMD=0 -DLEVELIZED=0 -DSCC_CONDENSED=0 -DEVENT_DRIVEN=0" \
+    "-DSIMD=0 -DINCREMENTAL=0" \
+    "-DINCREMENTAL=0 -DCONDENSED_LANES=1" \
+    "-DMEMO=0" \
+    "-DCANONICAL=1" \
+    "-DRNG=RNG_BULK" \
+    "-DRNG=RNG_PHILOX -DTHREADS=4" \
+    "-DFARM=1" \
+    "-DSTEADY_STATE=1 -DTHREADS=4" \
+    "-DISLANDS=4" \
+    "-DISLANDS=4 -DTOPOLOGY=TOPOLOGY_FULL" \
+    "-DISLANDS=4 -DPROCESSES=2" \
+    "-DEXPORT_CHAMPION=1"; do
+  echo "== configuration: $config"
+  build $config
+  run_checked
+done
+
+build
+for sizes in "--gates=16" "--gates=13 --circuits=800"; do
+  echo "== sizes: $sizes"
+  run_checked $sizes
+done
+
+seeded_run() {
+  (cd "$dir" && ./combinational --experiments=2 --seed=7 > "$1")
+}
+same_logs() {
+  if ! cmp -s "$dir/$1" "$dir/$2"; then
+    echo "$3"
+    exit 1
+  fi
+}
+for config in \
+    "-DFARM=1 -DTHREADS=1" \
+    "-DSTEADY_STATE=1 -DTHREADS=1" \
+    "-DISLANDS=1" \
+    "-DPROCESSES=1"; do
+  echo "== determinism: $config"
+  build $config
+  seeded_run first.log
+  seeded_run second.log
+  same_logs first.log second.log "two runs differ"
+done
+
+# Farm experiments draw from streams of their own, so the thread count
+# must not change them either.
+echo "== determinism: -DFARM=1 with 1 and 4 threads"
+build -DFARM=1 -DTHREADS=1
+seeded_run farm1.log
+build -DFARM=1 -DTHREADS=4
+seeded_run farm4.log
+same_logs farm1.log farm4.log "farm runs differ between 1 and 4 threads"
@@ -3,6 +3,14 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 
 #include "mt/SFMT.h"
 
@@ -13,28 +21,157 @@ typedef struct gate gate;
 
 #define SEED 1
 
+/* Default sizes; each can be changed at run time. The MAX_ bounds size
+ * the fixed buffers, and kernels are specialized for the common sizes in
+ * SIZED_KERNELS.
+ */
+#ifndef INPUTS
 #define INPUTS 4
+#endif
+#ifndef GATES
 #define GATES 12
+#endif
 #define INPUTS_PER_GATE 2
+#ifndef OUTPUTS
 #define OUTPUTS 1
-#define DNA_LENGTH (GATES * INPUTS_PER_GATE + OUTPUTS)
+#endif
+#ifndef MAX_INPUTS
+#define MAX_INPUTS 8
+#endif
+#ifndef MAX_GATES
+#define MAX_GATES 64
+#endif
+#ifndef MAX_OUTPUTS
+#define MAX_OUTPUTS 8
+#endif
+#define DNA_LENGTH (params.gates * INPUTS_PER_GATE + params.outputs)
+#define MAX_DNA_LENGTH (MAX_GATES * INPUTS_PER_GATE + MAX_OUTPUTS)
+#define MAX_SLOTS (MAX_INPUTS + MAX_GATES)
 
 #define MUTATION 0.7
 #define TRIALS 10000
 #define EPOCH 20
+#ifndef CIRCUITS
 #define CIRCUITS 1000
+#endif
+#define MAX_CIRCUITS (1 << 20)
 #define ELITE 300
 
 #define EXPERIMENTS 50
 
-#define CACHE_UNDEFINED -2
-#define MAX_CACHE 8
+#define MAX_TRUTH_TABLE 9
+#define MAX_GATE_FUNCTIONS 8
 
 #define DEGREE 11
 #define DEGREE_PENALTY 0.2
 
 #define UPDATE_INTERVAL 100
 
+#ifndef BITSLICED
+#define BITSLICED 1
+#endif
+#ifndef SIMD
+#define SIMD 1
+#endif
+#define REFERENCE_EVAL (!BITSLICED && !SIMD)
+#ifndef EVENT_DRIVEN
+#define EVENT_DRIVEN 1
+#endif
+#ifndef LEVELIZED
+#define LEVELIZED 1
+#endif
+#ifndef SCC_CONDENSED
+#define SCC_CONDENSED 1
+#endif
+#ifndef CONDENSED_LANES
+#define CONDENSED_LANES 0
+#endif
+#ifndef INCREMENTAL
+#define INCREMENTAL 1
+#endif
+/* Incremental evaluation keeps signals per DNA slot; the reference path
+ * always evaluates the gate graph.
+ */
+#if REFERENCE_EVAL
+#undef INCREMENTAL
+#define INCREMENTAL 0
+#endif
+#ifndef MEMO
+#define MEMO 1
+#endif
+#ifndef MEMO_ENTRIES
+#define MEMO_ENTRIES 4096
+#endif
+#ifndef CANONICAL
+#define CANONICAL 0
+#endif
+#ifndef EXPORT_CHAMPION
+#define EXPORT_CHAMPION 0
+#endif
+#ifndef CODEGEN_TESTS
+#define CODEGEN_TESTS 0   /* self-test compiled kernels (needs a C compiler) */
+#endif
+#ifndef THREADS
+#define THREADS 0
+#endif
+#ifndef FARM
+#define FARM 0
+#endif
+
+#define RNG_SFMT 0
+#define RNG_BULK 1
+#define RNG_PHILOX 2
+#ifndef RNG
+#define RNG RNG_SFMT
+#endif
+
+#ifndef STEADY_STATE
+#define STEADY_STATE 0
+#endif
+
+#ifndef ISLANDS
+#define ISLANDS 0   /* island threads; 0 evolves a single population */
+#endif
+#ifndef MIGRATION_INTERVAL
+#define MIGRATION_INTERVAL 20
+#endif
+#ifndef MIGRANTS
+#define MIGRANTS 4
+#endif
+#define MIGRATION_SLOTS 16
+#define TOPOLOGY_RING 0
+#define TOPOLOGY_FULL 1
+#ifndef TOPOLOGY
+#define TOPOLOGY TOPOLOGY_RING
+#endif
+#ifndef PROCESSES
+#define PROCESSES 0   /* island worker processes; 0 runs in this process */
+#endif
+#define MAX_THREADS 64
+#define CHAMPION_PATH "champion.c"
+
+/* Run parameters: the macros above are the defaults, and each can be
+ * changed at runtime from the command line or a config file.
+ */
+typedef struct {
+  int experiments;
+  uint32_t seed;
+  double mutation;
+  int epoch;
+  int elite;
+  int degree;
+  double degree_penalty;
+  int update_interval;
+  int inputs;
+  int gates;
+  int outputs;
+  int circuits;
+  int goals;  /* index into goal_sets */
+} parameters;
+
+static parameters params = {EXPERIMENTS, SEED, MUTATION, EPOCH, ELITE, DEGREE, DEGREE_PENALTY, UPDATE_INTERVAL,
+                            INPUTS, GATES, OUTPUTS, CIRCUITS, 0};
+
 struct gate {
   int (*fn)(int*);
   int fan_in;
@@ -45,10 +182,31 @@ struct gate {
   int num_outputs;
   int output_array_size;
   int value;
-  int* cache;
-  int cache_size;
+  int queued;
+  int opcode;
+  int slot;   /* scratch numbering for levelize and degree */
 };
 
+/* Strongly connected components of the gates in topological order of the
+ * condensation: component s holds order[scc_start[s]] up to (excluding)
+ * order[scc_start[s + 1]], and every fan-in of a gate lies in the same or
+ * an earlier component. scc_cyclic marks components that contain a cycle
+ * (more than one gate, or a gate feeding itself).
+ *
+ * live marks the gates that decide a pattern: the output cone, and every
+ * cyclic component with its fan-in closure, since a pattern only counts
+ * when all gates settle. Any other gate is acyclic logic feeding nothing
+ * on the way to an output, which settles whenever the live gates do.
+ */
+typedef struct {
+  int acyclic;
+  uint64_t live;
+  int num_sccs;
+  int order[MAX_GATES];
+  int scc_start[MAX_GATES + 1];
+  int scc_cyclic[MAX_GATES];
+} condensation;
+
 typedef struct {
   gate** gates;
   int num_gates;
@@ -56,6 +214,7 @@ typedef struct {
   int num_inputs;
   gate** output;
   int num_outputs;
+  condensation* condensed;
 } network;
 
 int subset(int i, int j) {
@@ -76,16 +235,6 @@ int subset_v(int* i, int* j, int length) {
   return 1;
 }
 
-int subset_v_gates(gate** i, int* j, int length) {
-  int x;
-  for (x = 0; x < length; x++) {
-    if (!subset(i[x]->value, j[x])) {
-      return 0;
-    }
-  }
-  return 1;
-}
-
 int partial_join(int i, int j) {
   if (i == j && (i == 0 || i == 1)) {
     return i;
@@ -110,7 +259,7 @@ int ternary_ext(int (*gate)(int*), int fan_in, int* inputs) {
   int check1 = 1;
   int i, j;
 
-  static int bin_input[MAX_FAN_IN];
+  int bin_input[MAX_FAN_IN];
   int max_val = 1 << fan_in;
   for (i = 0; i < max_val; i++) {
     for (j = 0; j < fan_in; j++) {
@@ -134,39 +283,10 @@ int ternary_ext(int (*gate)(int*), int fan_in, int* inputs) {
   }
 }
 
-int ternary_ext_gates(int (*gate)(int*), int fan_in, struct gate** inputs) {
-  int check0 = 1;
-  int check1 = 1;
-  int i, j;
-
-  static int bin_input[MAX_FAN_IN];
-  int max_val = 1 << fan_in;
-  for (i = 0; i < max_val; i++) {
-    for (j = 0; j < fan_in; j++) {
-      bin_input[j] = (i >> j) & 1;
-    }
-    if (subset_v_gates(inputs, bin_input, fan_in)) {
-      int output = gate(bin_input);
-      if (output == 0) {
-        check1 = 0;
-      } else if (output == 1) {
-        check0 = 0;
-      }
-    }
-  }
-  if (check0) {
-    return 0;
-  } else if (check1) {
-    return 1;
-  } else {
-    return INDETERMINATE;
-  }
-}
-
 void gen_truth_table(int* result, int (*gate)(int*), int fan_in, int ternary) {
   int i, j;
 
-  static int bin_input[MAX_FAN_IN];
+  int bin_input[MAX_FAN_IN];
   int max_val = 1;
   for (j = 0; j < fan_in; j++) {
     max_val *= (ternary ? 3 : 2);
@@ -186,7 +306,7 @@ void gen_truth_table(int* result, int (*gate)(int*), int fan_in, int ternary) {
   }
 }
 
-void connect(gate* g1, gate* g2) {
+void connect_gates(gate* g1, gate* g2) {
   int i;
   int not_in = 1;
 
@@ -210,54 +330,60 @@ void connect(gate* g1, gate* g2) {
   }
 }
 
-#define CACHE_BASE 3
+/* Ternary truth tables shared by every gate computing the same function,
+ * laid out as gen_truth_table produces them: input 0 is the most
+ * significant base-3 digit and INDETERMINATE is digit 2. A gate refers to
+ * its table by opcode.
+ */
+typedef struct {
+  int (*fn)(int*);
+  int fan_in;
+  int table[MAX_TRUTH_TABLE];
+} gate_function;
+
+static gate_function gate_functions[MAX_GATE_FUNCTIONS];
+static int num_gate_functions = 0;
+
+int gate_opcode(int (*fn)(int*), int fan_in) {
+  int i;
+  for (i = 0; i < num_gate_functions; i++) {
+    if (gate_functions[i].fn == fn && gate_functions[i].fan_in == fan_in) {
+      return i;
+    }
+  }
+  assert(num_gate_functions < MAX_GATE_FUNCTIONS);
+  gate_functions[i].fn = fn;
+  gate_functions[i].fan_in = fan_in;
+  gen_truth_table(gate_functions[i].table, fn, fan_in, 1);
+  return num_gate_functions++;
+}
 
-static inline int cache_val(int fan_in, int* vals) {
+static inline int ternary_index(int fan_in, int* vals) {
   int v = 0;
-  int multiplier = 1;
   int i;
   for (i = 0; i < fan_in; i++) {
-    v += (vals[i] == INDETERMINATE ? 2 : vals[i]) * multiplier;
-    multiplier *= CACHE_BASE;
+    v = v * 3 + (vals[i] == INDETERMINATE ? 2 : vals[i]);
   }
   return v;
 }
 
-static inline int cache_val_gate(int fan_in, gate** vals) {
+static inline int ternary_index_gate(int fan_in, gate** vals) {
   int v = 0;
-  int multiplier = 1;
   int i;
   for (i = 0; i < fan_in; i++) {
-    v += (vals[i]->value == INDETERMINATE ? 2 : vals[i]->value) * multiplier;
-    multiplier *= CACHE_BASE;
+    v = v * 3 + (vals[i]->value == INDETERMINATE ? 2 : vals[i]->value);
   }
   return v;
 }
 
 int eval_gate(gate* g) {
-  int cache_idx = cache_val_gate(g->num_inputs, g->inputs);
-  if (g->cache[cache_idx] != CACHE_UNDEFINED) {
-    g->value = g->cache[cache_idx];
-    return g->cache[cache_idx];
-  }
-
-  int result = ternary_ext_gates(g->fn, g->fan_in, g->inputs);
-  g->value = result;
-  g->cache[cache_idx] = result;
-  return result;
+  g->value = gate_functions[g->opcode].table[ternary_index_gate(g->fan_in, g->inputs)];
+  return g->value;
 }
 
 int eval_gate_inp(gate* g, int* vals) {
-  int cache_idx = cache_val(g->fan_in, vals);
-  if (g->cache[cache_idx] != CACHE_UNDEFINED) {
-    g->value = g->cache[cache_idx];
-    return g->cache[cache_idx];
-  }
-
-  int result = ternary_ext(g->fn, g->fan_in, vals);
-  g->value = result;
-  g->cache[cache_idx] = result;
-  return result;
+  g->value = gate_functions[g->opcode].table[ternary_index(g->fan_in, vals)];
+  return g->value;
 }
 
 int and_g(int* vals) {
@@ -447,20 +573,41 @@ void digital_display(int* output, int* inputs) {
   }
 }
 
+/* Goals a run can be given (the goals option); the inputs and outputs
+ * parameters must match the set's.
+ */
+#define MAX_GOALS 2
+
+typedef struct {
+  const char* name;
+  int inputs;
+  int outputs;
+  int num_goals;
+  void (*fns[MAX_GOALS])(int*, int*);
+} goal_set;
+
+static const goal_set goal_sets[] = {
+  {"modular", 4, 1, 2, {goal1, goal2}},
+  {"goal1", 4, 1, 1, {goal1}},
+  {"rivest", 3, 6, 1, {rivest}},
+  {"display", 3, 7, 1, {digital_display}},
+};
+
+#define NUM_GOAL_SETS ((int)(sizeof(goal_sets) / sizeof(goal_set)))
+
+/* Tables for the gate types circuits are built from are computed once at
+ * startup; any other function gets its table when its first gate is made.
+ */
+void init_gate_functions() {
+  gate_opcode(nand_g, 2);
+  gate_opcode(input_g, 1);
+}
+
 void make_gate(gate* g, int (*fn)(int*), int fan_in) {
   gate** inputs = (gate**)malloc(sizeof(gate*) * fan_in);
   gate** outputs = (gate**)malloc(sizeof(gate*));
 
-  g->cache_size = 1;
-  int i;
-  for (i = 0; i < fan_in; i++) {
-    g->cache_size *= 3;
-  }
-  int* cache = (int*)malloc(sizeof(int) * g->cache_size);
-  for (i = 0; i < g->cache_size; i++) {
-    cache[i] = CACHE_UNDEFINED;
-  }
-  g->cache = cache;
+  g->opcode = gate_opcode(fn, fan_in);
 
   g->fn = fn;
   g->fan_in = fan_in;
@@ -471,6 +618,8 @@ void make_gate(gate* g, int (*fn)(int*), int fan_in) {
   g->num_outputs = 0;
   g->output_array_size = 1;
   g->value = INDETERMINATE;
+  g->queued = 0;
+  g->slot = -1;
 }
 
 void reset_gate(gate* g) {
@@ -479,124 +628,227 @@ void reset_gate(gate* g) {
   g->value = INDETERMINATE;
 }
 
-int has_cycle(network* n) {
-  static gate* examine[INPUTS + GATES];
-  static gate* stack[INPUTS + GATES];
-  int examine_len = 0;
-  int stack_len = 0;
-  int i, j, k;
-  
+/* The number of outputs plus the other gates (and inputs, if
+ * include_inputs) that can reach an output, so a gate driving several
+ * outputs counts once per output. The cone is a fixed point over gate
+ * fan-in masks indexed through the slot field (gates first, then
+ * inputs); the inputs it reaches are collected in a mask of their own.
+ */
+int degree(network* n, int include_inputs) {
+  assert(n->num_gates <= 64 && n->num_inputs <= 64);
+  uint64_t gate_fan_in[64];
+  uint64_t input_fan_in[64];
+  int i, j;
+
+  for (i = 0; i < n->num_gates; i++) {
+    n->gates[i]->slot = i;
+  }
   for (i = 0; i < n->num_inputs; i++) {
-    examine[examine_len++] = n->inputs[i];
+    n->inputs[i]->slot = n->num_gates + i;
   }
   for (i = 0; i < n->num_gates; i++) {
-    examine[examine_len++] = n->gates[i];
-  }
-  
-  int breaking;
-  
-  gate* node;
-  while (examine_len > 0) {
-    node = examine[--examine_len];
-    stack[0] = node;
-    stack_len = 1;
-    while (stack_len > 0) {
-      gate* top = stack[stack_len - 1];
-      breaking = 0;
-      for (i = 0; i < top->num_outputs; i++) {
-        node = top->outputs[i];
-        for (j = 0; j < stack_len; j++) {
-          if (node == stack[j]) {
-            return 1;
-          }
-        }
-        int found = 0;
-        for (j = 0; j < examine_len; j++) {
-          if (examine[j] == node) {
-            found = 1;
-            break;
-          }
-        }
-        if (found) {
-          stack[stack_len++] = node;
-          j = 0;
-          for (k = 0; k < examine_len; k++) {
-            if (examine[k] == node) {
-              j = 1;
-            }
-            examine[k] = examine[k + j];
-          }
-          examine_len--;
-          breaking = 1;
-          break;
-        }
-      }
-      if (!breaking) {
-        node = stack[--stack_len];
+    gate_fan_in[i] = 0;
+    input_fan_in[i] = 0;
+    for (j = 0; j < n->gates[i]->num_inputs; j++) {
+      int slot = n->gates[i]->inputs[j]->slot;
+      if (slot < n->num_gates) {
+        gate_fan_in[i] |= (uint64_t)1 << slot;
+      } else {
+        input_fan_in[i] |= (uint64_t)1 << (slot - n->num_gates);
       }
     }
   }
-  
-  return 0;
-}
 
-int degree(network* n, int include_inputs) {
-  int i, j, k;
-  for (i = 0; i < n->num_gates; i++) {
-    n->gates[i]->value = INDETERMINATE;
+  uint64_t outputs = 0;
+  uint64_t output_inputs = 0;
+  for (i = 0; i < n->num_outputs; i++) {
+    int slot = n->output[i]->slot;
+    if (slot < n->num_gates) {
+      outputs |= (uint64_t)1 << slot;
+    } else {
+      output_inputs |= (uint64_t)1 << (slot - n->num_gates);
+    }
+  }
+  uint64_t cone = outputs;
+  uint64_t inputs = output_inputs;
+  uint64_t frontier = cone;
+  while (frontier) {
+    int g = __builtin_ctzll(frontier);
+    uint64_t reached = gate_fan_in[g] & ~cone;
+    inputs |= input_fan_in[g];
+    frontier &= frontier - 1;
+    cone |= reached;
+    frontier |= reached;
+  }
+  int count = n->num_outputs + __builtin_popcountll(cone & ~outputs);
+  if (include_inputs) {
+    count += __builtin_popcountll(inputs & ~output_inputs);
   }
+  return count;
+}
 
+static int network_slot(network* n, gate* g) {
+  int i;
   for (i = 0; i < n->num_inputs; i++) {
-    n->inputs[i]->value = INDETERMINATE;
+    if (n->inputs[i] == g) {
+      return i;
+    }
   }
+  for (i = 0; i < n->num_gates; i++) {
+    if (n->gates[i] == g) {
+      return n->num_inputs + i;
+    }
+  }
+  assert(0);
+  return -1;
+}
 
-  static gate* gates_encountered[GATES];
-  static gate* next_layer[GATES];
-
-  int gates_encountered_size = n->num_outputs;
+/* Tarjan's algorithm over the fan-in lists, with an explicit call stack.
+ * Following fan-in edges means a component is completed only after every
+ * component feeding it, so components come out in evaluation order.
+ * fan_in entries below zero are primary inputs.
+ */
+void condense_fan_in(condensation* c, int num_gates, int fan_in[][MAX_FAN_IN], const int* num_fan_in, uint64_t outputs) {
+  int index[MAX_GATES];
+  int low[MAX_GATES];
+  int on_stack[MAX_GATES];
+  int stack[MAX_GATES];
+  int call[MAX_GATES];
+  int next[MAX_GATES];
+  int stack_len = 0;
+  int counter = 0;
+  int num_placed = 0;
+  int i;
 
-  int effective = 0;
-  for (i = 0; i < n->num_outputs; i++) {
-    gates_encountered[i] = n->output[i];
-    n->output[i]->value = 1;
-    effective++;
+  c->num_sccs = 0;
+  c->acyclic = 1;
+  for (i = 0; i < num_gates; i++) {
+    index[i] = -1;
+    on_stack[i] = 0;
   }
-
-  while (1) {
-    int next_layer_size = 0;
-    for (i = 0; i < gates_encountered_size; i++) {
-      for (j = 0; j < gates_encountered[i]->num_inputs; j++) {
-        if (!include_inputs) {
-          int skip = 0;
-          for (k = 0; k < n->num_inputs; k++) {
-            if (gates_encountered[i]->inputs[j] == n->inputs[k]) {
-              skip = 1;
-              break;
-            }
-          }
-          if (skip) {
-            continue;
-          }
+  for (i = 0; i < num_gates; i++) {
+    if (index[i] != -1) {
+      continue;
+    }
+    int top = 0;
+    call[0] = i;
+    next[0] = 0;
+    index[i] = low[i] = counter++;
+    stack[stack_len++] = i;
+    on_stack[i] = 1;
+    while (top >= 0) {
+      int g = call[top];
+      if (next[top] < num_fan_in[g]) {
+        int h = fan_in[g][next[top]++];
+        if (h < 0) {
+          continue;
+        }
+        if (index[h] == -1) {
+          index[h] = low[h] = counter++;
+          stack[stack_len++] = h;
+          on_stack[h] = 1;
+          top++;
+          call[top] = h;
+          next[top] = 0;
+        } else if (on_stack[h] && index[h] < low[g]) {
+          low[g] = index[h];
+        }
+        continue;
+      }
+      if (low[g] == index[g]) {
+        int h;
+        c->scc_start[c->num_sccs] = num_placed;
+        do {
+          h = stack[--stack_len];
+          on_stack[h] = 0;
+          c->order[num_placed++] = h;
+        } while (h != g);
+        int cyclic = num_placed - c->scc_start[c->num_sccs] > 1;
+        for (h = 0; h < num_fan_in[g]; h++) {
+          cyclic |= fan_in[g][h] == g;
         }
-        if (gates_encountered[i]->inputs[j]->value == INDETERMINATE) {
-          next_layer[next_layer_size++] = gates_encountered[i]->inputs[j];
-          gates_encountered[i]->inputs[j]->value = 1;
-          effective++;
+        c->scc_cyclic[c->num_sccs++] = cyclic;
+        c->acyclic &= !cyclic;
+      }
+      top--;
+      if (top >= 0 && low[g] < low[call[top]]) {
+        low[call[top]] = low[g];
+      }
+    }
+  }
+  c->scc_start[c->num_sccs] = num_placed;
+
+  /* Fan-ins lie in the same or an earlier component, so one pass in
+   * reverse order closes the live set.
+   */
+  int s;
+  c->live = outputs;
+  for (s = c->num_sccs - 1; s >= 0; s--) {
+    for (i = c->scc_start[s]; i < c->scc_start[s + 1]; i++) {
+      int g = c->order[i];
+      if (c->scc_cyclic[s]) {
+        c->live |= (uint64_t)1 << g;
+      }
+      if (!((c->live >> g) & 1)) {
+        continue;
+      }
+      int j;
+      for (j = 0; j < num_fan_in[g]; j++) {
+        if (fan_in[g][j] >= 0) {
+          c->live |= (uint64_t)1 << fan_in[g][j];
         }
       }
     }
-    if (next_layer_size == 0) {
-      return effective;
+  }
+}
+
+/* Condenses the network once per circuit into n->condensed. Returns 1
+ * when the network is acyclic. Gates are numbered through their slot
+ * field first, so the whole pass is linear in gates and wires.
+ */
+int levelize(network* n) {
+  assert(n->num_gates <= MAX_GATES);
+  int fan_in[MAX_GATES][MAX_FAN_IN];
+  int num_fan_in[MAX_GATES];
+  int i, j;
+
+  for (i = 0; i < n->num_inputs; i++) {
+    n->inputs[i]->slot = -1;
+  }
+  for (i = 0; i < n->num_gates; i++) {
+    n->gates[i]->slot = i;
+  }
+  for (i = 0; i < n->num_gates; i++) {
+    assert(n->gates[i]->num_inputs <= MAX_FAN_IN);
+    num_fan_in[i] = n->gates[i]->num_inputs;
+    for (j = 0; j < num_fan_in[i]; j++) {
+      fan_in[i][j] = n->gates[i]->inputs[j]->slot;
     }
-    
-    for (i = 0; i < next_layer_size; i++) {
-      gates_encountered[i] = next_layer[i];
+  }
+  uint64_t outputs = 0;
+  for (i = 0; i < n->num_outputs; i++) {
+    if (n->output[i]->slot >= 0) {
+      outputs |= (uint64_t)1 << n->output[i]->slot;
     }
-    gates_encountered_size = next_layer_size;
   }
+  if (n->condensed == NULL) {
+    n->condensed = (condensation*)malloc(sizeof(condensation));
+  }
+  condense_fan_in(n->condensed, n->num_gates, fan_in, num_fan_in, outputs);
+  return n->condensed->acyclic;
 }
 
-int eval_network(int* output, network* n, int* vals) {
+/* The cycle flag comes with the condensation, which stays cached for the
+ * evaluator until circuitize rewires the network.
+ */
+int has_cycle(network* n) {
+  if (n->condensed == NULL) {
+    levelize(n);
+  }
+  return !n->condensed->acyclic;
+}
+
+int eval_network_sweep(int* output, network* n, int* vals) {
   int i;
   for (i = 0; i < n->num_gates; i++) {
     n->gates[i]->value = INDETERMINATE;
@@ -605,7 +857,7 @@ int eval_network(int* output, network* n, int* vals) {
     n->inputs[i]->value = vals[i];
   }
 
-  static int gates_to_eval[GATES];
+  int gates_to_eval[MAX_GATES];
   for (i = 0; i < n->num_gates; i++) {
     gates_to_eval[i] = 1;
   }
@@ -638,20 +890,166 @@ int eval_network(int* output, network* n, int* vals) {
   return 1;
 }
 
+/* Event-driven version of eval_network_sweep: a gate is re-evaluated only
+ * when one of its fan-ins has just settled, so the work is proportional to
+ * the number of signal changes. Every gate function here is INDETERMINATE
+ * when all of its fan-ins are, so seeding the worklist with the fan-outs
+ * of the inputs reaches the same fixpoint.
+ */
+int eval_network_worklist(int* output, network* n, int* vals) {
+  assert(n->num_gates <= MAX_GATES);
+  gate* queue[MAX_GATES];
+  int head = 0;
+  int size = 0;
+  int i, j;
+
+  for (i = 0; i < n->num_gates; i++) {
+    n->gates[i]->value = INDETERMINATE;
+    n->gates[i]->queued = 0;
+  }
+  for (i = 0; i < n->num_inputs; i++) {
+    n->inputs[i]->value = vals[i];
+  }
+  for (i = 0; i < n->num_inputs; i++) {
+    for (j = 0; j < n->inputs[i]->num_outputs; j++) {
+      gate* g = n->inputs[i]->outputs[j];
+      if (!g->queued) {
+        g->queued = 1;
+        queue[(head + size++) % params.gates] = g;
+      }
+    }
+  }
+
+  while (size > 0) {
+    gate* g = queue[head];
+    head = (head + 1) % params.gates;
+    size--;
+    g->queued = 0;
+    if (eval_gate(g) == INDETERMINATE) {
+      continue;
+    }
+    for (j = 0; j < g->num_outputs; j++) {
+      gate* next = g->outputs[j];
+      if (!next->queued && next->value == INDETERMINATE) {
+        next->queued = 1;
+        queue[(head + size++) % params.gates] = next;
+      }
+    }
+  }
+
+  for (i = 0; i < n->num_gates; i++) {
+    if (n->gates[i]->value == INDETERMINATE) {
+      output[0] = INDETERMINATE;
+      return 0;
+    }
+  }
+  for (i = 0; i < n->num_outputs; i++) {
+    output[i] = n->output[i]->value;
+  }
+  return 1;
+}
+
+/* Single pass in topological order over the live gates; only valid once
+ * levelize has found the network acyclic, in which case every gate
+ * settles.
+ */
+int eval_network_levelized(int* output, network* n, int* vals) {
+  condensation* c = n->condensed;
+  int i;
+  for (i = 0; i < n->num_inputs; i++) {
+    n->inputs[i]->value = vals[i];
+  }
+  for (i = 0; i < n->num_gates; i++) {
+    if ((c->live >> c->order[i]) & 1) {
+      eval_gate(n->gates[c->order[i]]);
+    }
+  }
+  for (i = 0; i < n->num_outputs; i++) {
+    output[i] = n->output[i]->value;
+  }
+  return 1;
+}
+
+/* Evaluates the live part of the condensation in topological order:
+ * gates outside cycles are evaluated once, and the ternary fixpoint only
+ * iterates inside each cyclic component, whose fan-ins from earlier
+ * components are final.
+ */
+int eval_network_condensed(int* output, network* n, int* vals) {
+  condensation* c = n->condensed;
+  int i, s;
+  for (i = 0; i < n->num_gates; i++) {
+    n->gates[i]->value = INDETERMINATE;
+  }
+  for (i = 0; i < n->num_inputs; i++) {
+    n->inputs[i]->value = vals[i];
+  }
+
+  for (s = 0; s < c->num_sccs; s++) {
+    if (!((c->live >> c->order[c->scc_start[s]]) & 1)) {
+      continue;
+    }
+    if (!c->scc_cyclic[s]) {
+      eval_gate(n->gates[c->order[c->scc_start[s]]]);
+      continue;
+    }
+    int changed = 1;
+    while (changed) {
+      changed = 0;
+      for (i = c->scc_start[s]; i < c->scc_start[s + 1]; i++) {
+        gate* g = n->gates[c->order[i]];
+        if (g->value == INDETERMINATE && eval_gate(g) != INDETERMINATE) {
+          changed = 1;
+        }
+      }
+    }
+  }
+
+  for (i = 0; i < n->num_gates; i++) {
+    if (((c->live >> i) & 1) && n->gates[i]->value == INDETERMINATE) {
+      output[0] = INDETERMINATE;
+      return 0;
+    }
+  }
+  for (i = 0; i < n->num_outputs; i++) {
+    output[i] = n->output[i]->value;
+  }
+  return 1;
+}
+
+int eval_network(int* output, network* n, int* vals) {
+#if LEVELIZED || SCC_CONDENSED
+  if (n->condensed == NULL) {
+    levelize(n);
+  }
+#endif
+#if LEVELIZED
+  if (n->condensed->acyclic) {
+    return eval_network_levelized(output, n, vals);
+  }
+#endif
+#if SCC_CONDENSED
+  return eval_network_condensed(output, n, vals);
+#elif EVENT_DRIVEN
+  return eval_network_worklist(output, n, vals);
+#else
+  return eval_network_sweep(output, n, vals);
+#endif
+}
+
 void eval_network_all(int** outputs, network* n) {
   int i,j;
   int max_val = 1 << n->num_inputs;
 
   int* bin_input = (int*)malloc(sizeof(int) * n->num_inputs);
-  int* output = (int*)malloc(sizeof(int) * n->num_outputs);
 
   for (i = 0; i < max_val; i++) {
+    int* output = (int*)malloc(sizeof(int) * n->num_outputs);
     for (j = 0; j < n->num_inputs; j++) {
       bin_input[n->num_inputs - j - 1] = (i >> j) & 1;
     }
     eval_network(output, n, bin_input);
     outputs[i] = output;
-    output = (int*)malloc(sizeof(int) * n->num_outputs);
   }
   free(bin_input);
 }
@@ -661,7 +1059,7 @@ double eval_network_fitness(network* n, int (*fn)(int*)) {
   int i,j;
   int max_val = 1 << n->num_inputs;
 
-  static int bin_input[INPUTS];
+  int bin_input[MAX_INPUTS];
   int output[1];
 
   int total = 0;
@@ -685,9 +1083,9 @@ double eval_network_fitness_vector(network* n, void (*fn)(int*, int*)) {
   int i,j;
   int max_val = 1 << n->num_inputs;
 
-  static int bin_input[INPUTS];
-  static int output[OUTPUTS];
-  static int test_output[OUTPUTS];
+  int bin_input[MAX_INPUTS];
+  int output[MAX_OUTPUTS];
+  int test_output[MAX_OUTPUTS] = {0};
 
   int total = 0;
   int correct = 0;
@@ -711,44 +1109,4053 @@ double eval_network_fitness_vector(network* n, void (*fn)(int*, int*)) {
   return (double)correct / total;
 }
 
-void assertTrue(const char* test, int expr) {
-  if (expr) {
-    printf("%s: PASSED\n", test);
-  } else {
-    printf("%s: FAILED\n", test);
+/* Bit-sliced dual-rail evaluation. Each signal is kept as two words:
+ * bit k of `zero` is set when the signal can be 0 under input pattern k,
+ * bit k of `one` when it can be 1. A settled signal has exactly one of
+ * the two bits set; INDETERMINATE has both. One fixpoint pass over the
+ * words evaluates PATTERN_BITS input patterns at once.
+ */
+
+typedef uint64_t pattern_word;
+
+typedef struct {
+  pattern_word zero;
+  pattern_word one;
+} dual_rail;
+
+#define PATTERN_BITS 64
+#define LOG_PATTERN_BITS 6
+
+enum {
+  GATE_GENERIC,
+  GATE_AND,
+  GATE_OR,
+  GATE_XOR,
+  GATE_NOT,
+  GATE_NAND,
+  GATE_INPUT
+};
+
+static const pattern_word pattern_masks[LOG_PATTERN_BITS] = {
+  0xAAAAAAAAAAAAAAAAULL,
+  0xCCCCCCCCCCCCCCCCULL,
+  0xF0F0F0F0F0F0F0F0ULL,
+  0xFF00FF00FF00FF00ULL,
+  0xFFFF0000FFFF0000ULL,
+  0xFFFFFFFF00000000ULL
+};
+
+int gate_op(int (*fn)(int*)) {
+  if (fn == and_g) {
+    return GATE_AND;
+  } else if (fn == or_g) {
+    return GATE_OR;
+  } else if (fn == xor_g) {
+    return GATE_XOR;
+  } else if (fn == not_g) {
+    return GATE_NOT;
+  } else if (fn == nand_g) {
+    return GATE_NAND;
+  } else if (fn == input_g) {
+    return GATE_INPUT;
   }
+  return GATE_GENERIC;
 }
 
-void assertListEq(const char* test, int* l1, int* l2, int length) {
-  int i;
-  for (i = 0; i < length; i++) {
-    if (l1[i] != l2[i]) {
-      printf("%s: FAILED\n", test);
-      return;
-    }
+static inline pattern_word block_mask(int num_inputs) {
+  if (num_inputs >= LOG_PATTERN_BITS) {
+    return ~(pattern_word)0;
   }
-  printf("%s: PASSED\n", test);
+  return ((pattern_word)1 << (1 << num_inputs)) - 1;
 }
 
-void assertMatrixEq(const char* test, int** l1, int** l2, int length, int sublength) {
-  int i, j;
-  for (i = 0; i < length; i++) {
+/* Patterns are numbered as in eval_network_fitness_vector: input 0 is the
+ * most significant bit of the pattern index.
+ */
+static inline pattern_word input_pattern(int input, int num_inputs, int block) {
+  int shift = num_inputs - input - 1;
+  if (shift < LOG_PATTERN_BITS) {
+    return pattern_masks[shift];
+  }
+  return ((block >> (shift - LOG_PATTERN_BITS)) & 1) ? ~(pattern_word)0 : 0;
+}
+
+static inline dual_rail dual_and(dual_rail a, dual_rail b) {
+  dual_rail r = {a.zero | b.zero, a.one & b.one};
+  return r;
+}
+
+static inline dual_rail dual_or(dual_rail a, dual_rail b) {
+  dual_rail r = {a.zero & b.zero, a.one | b.one};
+  return r;
+}
+
+static inline dual_rail dual_xor(dual_rail a, dual_rail b) {
+  dual_rail r = {(a.zero & b.zero) | (a.one & b.one), (a.zero & b.one) | (a.one & b.zero)};
+  return r;
+}
+
+static inline dual_rail dual_not(dual_rail a) {
+  dual_rail r = {a.one, a.zero};
+  return r;
+}
+
+static inline dual_rail dual_nand(dual_rail a, dual_rail b) {
+  dual_rail r = {a.one & b.one, a.zero | b.zero};
+  return r;
+}
+
+/* Ternary extension of an arbitrary gate function: the output can take
+ * value v under a pattern if some binary input assignment compatible with
+ * the inputs under that pattern produces v.
+ */
+dual_rail dual_generic(int (*fn)(int*), int fan_in, dual_rail* in) {
+  int bin_input[MAX_FAN_IN];
+  dual_rail r = {0, 0};
+  int i, j;
+  for (i = 0; i < (1 << fan_in); i++) {
+    pattern_word m = ~(pattern_word)0;
+    for (j = 0; j < fan_in; j++) {
+      bin_input[j] = (i >> j) & 1;
+      m &= bin_input[j] ? in[j].one : in[j].zero;
+    }
+    if (fn(bin_input)) {
+      r.one |= m;
+    } else {
+      r.zero |= m;
+    }
+  }
+  return r;
+}
+
+static inline dual_rail eval_gate_dual(int op, gate* g, dual_rail* in) {
+  switch (op) {
+    case GATE_AND:
+      return dual_and(in[0], in[1]);
+    case GATE_OR:
+      return dual_or(in[0], in[1]);
+    case GATE_XOR:
+      return dual_xor(in[0], in[1]);
+    case GATE_NOT:
+      return dual_not(in[0]);
+    case GATE_NAND:
+      return dual_nand(in[0], in[1]);
+    case GATE_INPUT:
+      return in[0];
+    default:
+      return dual_generic(g->fn, g->fan_in, in);
+  }
+}
+
+/* Evaluates the block of PATTERN_BITS input patterns starting at pattern
+ * block * PATTERN_BITS. Output signals are written to `output`; the return
+ * value has bit k set when every gate settled under pattern k, which is
+ * exactly when eval_network returns 1 for that pattern.
+ */
+pattern_word eval_network_bitsliced(dual_rail* output, network* n, int block) {
+  assert(n->num_inputs + n->num_gates <= MAX_SLOTS);
+  assert(n->num_gates <= MAX_GATES);
+
+  dual_rail signal[MAX_SLOTS];
+  int in_slot[MAX_GATES][MAX_FAN_IN];
+  int op[MAX_GATES];
+  pattern_word mask = block_mask(n->num_inputs);
+  int i, j;
+
+  for (i = 0; i < n->num_inputs; i++) {
+    signal[i].one = input_pattern(i, n->num_inputs, block) & mask;
+    signal[i].zero = ~signal[i].one & mask;
+  }
+  for (i = 0; i < n->num_gates; i++) {
+    gate* g = n->gates[i];
+    op[i] = gate_op(g->fn);
+    for (j = 0; j < g->fan_in; j++) {
+      in_slot[i][j] = network_slot(n, g->inputs[j]);
+    }
+    signal[n->num_inputs + i].zero = mask;
+    signal[n->num_inputs + i].one = mask;
+  }
+
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (i = 0; i < n->num_gates; i++) {
+      dual_rail in[MAX_FAN_IN];
+      for (j = 0; j < n->gates[i]->fan_in; j++) {
+        in[j] = signal[in_slot[i][j]];
+      }
+      dual_rail r = eval_gate_dual(op[i], n->gates[i], in);
+      dual_rail* s = &signal[n->num_inputs + i];
+      changed |= (r.zero != s->zero) | (r.one != s->one);
+      *s = r;
+    }
+  }
+
+  pattern_word unsettled = 0;
+  for (i = 0; i < n->num_gates; i++) {
+    unsettled |= signal[n->num_inputs + i].zero & signal[n->num_inputs + i].one;
+  }
+  for (i = 0; i < n->num_outputs; i++) {
+    output[i] = signal[network_slot(n, n->output[i])];
+  }
+  return mask & ~unsettled;
+}
+
+double eval_network_fitness_bitsliced(network* n, void (*fn)(int*, int*)) {
+  assert(n->num_outputs <= MAX_OUTPUTS);
+  int max_val = 1 << n->num_inputs;
+  int blocks = (max_val + PATTERN_BITS - 1) / PATTERN_BITS;
+  int i, j, k, b;
+
+  int bin_input[MAX_INPUTS];
+  int test_output[MAX_OUTPUTS] = {0};
+  dual_rail output[MAX_OUTPUTS];
+  pattern_word expected[MAX_OUTPUTS] = {0};
+
+  int correct = 0;
+  for (b = 0; b < blocks; b++) {
+    pattern_word settled = eval_network_bitsliced(output, n, b);
+    for (j = 0; j < n->num_outputs; j++) {
+      expected[j] = 0;
+    }
+    for (k = 0; k < PATTERN_BITS && b * PATTERN_BITS + k < max_val; k++) {
+      int pattern = b * PATTERN_BITS + k;
+      for (i = 0; i < n->num_inputs; i++) {
+        bin_input[n->num_inputs - i - 1] = (pattern >> i) & 1;
+      }
+      fn(test_output, bin_input);
+      for (j = 0; j < n->num_outputs; j++) {
+        expected[j] |= (pattern_word)(test_output[j] & 1) << k;
+      }
+    }
+    for (j = 0; j < n->num_outputs; j++) {
+      correct += __builtin_popcountll(settled & ~(output[j].one ^ expected[j]));
+    }
+  }
+
+  return (double)correct / (max_val * n->num_outputs);
+}
+
+/* Population-parallel evaluation straight from the DNA: each SIMD lane
+ * holds the dual-rail state of a different circuit, and gathers follow
+ * every circuit's own wiring. DNA addresses are used as slot numbers
+ * directly (inputs first, then gates).
+ */
+
+#define PATTERNS (1 << params.inputs)
+#define PATTERN_BLOCKS(inputs) (((1 << (inputs)) + PATTERN_BITS - 1) / PATTERN_BITS)
+#define PATTERN_WORDS PATTERN_BLOCKS(params.inputs)
+#define SLOTS (params.inputs + params.gates)
+#define MAX_PATTERN_WORDS PATTERN_BLOCKS(MAX_INPUTS)
+
+#if MAX_GATES > 64
+#error "gate masks are 64 bits wide"
+#endif
+
+/* Genes hold slot numbers, so a byte per gene is enough. */
+typedef uint8_t gene;
+#if MAX_SLOTS > 256
+#error "genes are 8 bits wide"
+#endif
+#define MAX_LANES 8
+
+typedef struct {
+  pattern_word expected[MAX_OUTPUTS][MAX_PATTERN_WORDS];
+} goal_table;
+
+typedef struct {
+  int32_t fan_in[MAX_GATES][INPUTS_PER_GATE][MAX_LANES];
+  int output[MAX_OUTPUTS][MAX_LANES];
+  int lanes;
+  int acyclic;
+  const condensation* condensed;
+} lane_wiring;
+
+typedef struct {
+  const char* name;
+  const char* isa;
+  int lanes;
+} simd_engine;
+
+void make_goal_table(goal_table* t, void (*fn)(int*, int*)) {
+  int bin_input[MAX_INPUTS];
+  int test_output[MAX_OUTPUTS] = {0};
+  int i, j;
+  memset(t, 0, sizeof(goal_table));
+  for (i = 0; i < PATTERNS; i++) {
+    for (j = 0; j < params.inputs; j++) {
+      bin_input[params.inputs - j - 1] = (i >> j) & 1;
+    }
+    fn(test_output, bin_input);
+    for (j = 0; j < params.outputs; j++) {
+      t->expected[j][i / PATTERN_BITS] |= (pattern_word)(test_output[j] & 1) << (i % PATTERN_BITS);
+    }
+  }
+}
+
+/* The hot DNA kernels are written once as KERNEL bodies taking the
+ * sizes as arguments. SIZED_KERNELS instantiates them for common sizes,
+ * where the sizes fold to constants as they did when they were macros,
+ * and once more with the sizes read from params as the fallback.
+ */
+#define KERNEL static inline __attribute__((always_inline))
+
+/* Output genes name a gate: like circuitize, an address below the input
+ * count selects gate `address` rather than an input.
+ */
+KERNEL int output_slot_sized(int address, int inputs) {
+  return inputs + (address >= inputs ? address - inputs : address);
+}
+
+KERNEL uint64_t dna_outputs_sized(const gene* dna, int inputs, int gates, int outputs) {
+  uint64_t mask = 0;
+  int i;
+  for (i = 0; i < outputs; i++) {
+    mask |= (uint64_t)1 << (output_slot_sized(dna[gates * INPUTS_PER_GATE + i], inputs) - inputs);
+  }
+  return mask;
+}
+
+static inline int dna_output_slot(int address) {
+  return output_slot_sized(address, params.inputs);
+}
+
+static inline uint64_t dna_outputs(const gene* dna) {
+  return dna_outputs_sized(dna, params.inputs, params.gates, params.outputs);
+}
+
+void condense_dna(const gene* dna, condensation* c) {
+  int fan_in[MAX_GATES][MAX_FAN_IN];
+  int num_fan_in[MAX_GATES];
+  int i, j;
+  for (i = 0; i < params.gates; i++) {
+    num_fan_in[i] = INPUTS_PER_GATE;
+    for (j = 0; j < INPUTS_PER_GATE; j++) {
+      fan_in[i][j] = dna[i * INPUTS_PER_GATE + j] - params.inputs;
+    }
+  }
+  condense_fan_in(c, params.gates, fan_in, num_fan_in, dna_outputs(dna));
+}
+
+/* Lane l evaluates gate cond[l]->order[t] at position t, so positions
+ * follow the condensation and an acyclic lane settles in a single pass.
+ * A NULL `cond` keeps the DNA numbering.
+ */
+void wire_lanes(lane_wiring* w, gene** dna, condensation** cond, int count, int lanes) {
+  int rank[MAX_GATES];
+  int i, j, l;
+  w->lanes = lanes;
+  for (l = 0; l < lanes; l++) {
+    int src = l < count ? l : count - 1;
+    gene* d = dna[src];
+    for (i = 0; i < params.gates; i++) {
+      rank[cond ? cond[src]->order[i] : i] = i;
+    }
+    for (i = 0; i < params.gates; i++) {
+      int g = cond ? cond[src]->order[i] : i;
+      for (j = 0; j < INPUTS_PER_GATE; j++) {
+        int address = d[g * INPUTS_PER_GATE + j];
+        int slot = address < params.inputs ? address : params.inputs + rank[address - params.inputs];
+        w->fan_in[i][j][l] = slot * lanes + l;
+      }
+    }
+    for (i = 0; i < params.outputs; i++) {
+      int slot = dna_output_slot(d[params.gates * INPUTS_PER_GATE + i]);
+      w->output[i][l] = (params.inputs + rank[slot - params.inputs]) * lanes + l;
+    }
+  }
+}
+
+static void init_lanes(pattern_word* zero, pattern_word* one, int lanes, int block) {
+  pattern_word mask = block_mask(params.inputs);
+  int i, l;
+  for (i = 0; i < SLOTS; i++) {
+    pattern_word z = mask, o = mask;
+    if (i < params.inputs) {
+      o = input_pattern(i, params.inputs, block) & mask;
+      z = ~o & mask;
+    }
+    for (l = 0; l < lanes; l++) {
+      zero[i * lanes + l] = z;
+      one[i * lanes + l] = o;
+    }
+  }
+}
+
+static void score_lanes(int* correct, pattern_word* zero, pattern_word* one,
+                        const lane_wiring* w, const goal_table* goal, int block) {
+  int lanes = w->lanes;
+  int i, l;
+  for (l = 0; l < lanes; l++) {
+    pattern_word unsettled = 0;
+    for (i = params.inputs; i < SLOTS; i++) {
+      unsettled |= zero[i * lanes + l] & one[i * lanes + l];
+    }
+    pattern_word settled = block_mask(params.inputs) & ~unsettled;
+    for (i = 0; i < params.outputs; i++) {
+      pattern_word out = one[w->output[i][l]];
+      correct[l] += __builtin_popcountll(settled & ~(out ^ goal->expected[i][block]));
+    }
+  }
+}
+
+KERNEL pattern_word eval_position(pattern_word* zero, pattern_word* one, const lane_wiring* w, int i, int l,
+                                  int inputs) {
+  int a = w->fan_in[i][0][l];
+  int b = w->fan_in[i][1][l];
+  int s = (inputs + i) * w->lanes + l;
+  pattern_word z = one[a] & one[b];
+  pattern_word o = zero[a] | zero[b];
+  pattern_word diff = (z ^ zero[s]) | (o ^ one[s]);
+  zero[s] = z;
+  one[s] = o;
+  return diff;
+}
+
+/* A single condensed lane only iterates inside its cyclic components. */
+KERNEL void fixpoint_condensed(pattern_word* zero, pattern_word* one, const lane_wiring* w, int inputs) {
+  const condensation* c = w->condensed;
+  int i, s;
+  for (s = 0; s < c->num_sccs; s++) {
+    pattern_word diff;
+    do {
+      diff = 0;
+      for (i = c->scc_start[s]; i < c->scc_start[s + 1]; i++) {
+        diff |= eval_position(zero, one, w, i, 0, inputs);
+      }
+    } while (c->scc_cyclic[s] && diff);
+  }
+}
+
+KERNEL void fixpoint_scalar(pattern_word* zero, pattern_word* one, const lane_wiring* w, int inputs, int gates) {
+  int lanes = w->lanes;
+  int i, l;
+  pattern_word diff;
+  if (w->condensed) {
+    fixpoint_condensed(zero, one, w, inputs);
+    return;
+  }
+  do {
+    diff = 0;
+    for (i = 0; i < gates; i++) {
+      for (l = 0; l < lanes; l++) {
+        diff |= eval_position(zero, one, w, i, l, inputs);
+      }
+    }
+  } while (!w->acyclic && diff);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+KERNEL void fixpoint_sse2(pattern_word* zero, pattern_word* one, const lane_wiring* w, int inputs, int gates) {
+  __m128i* z = (__m128i*)zero + inputs;
+  __m128i* o = (__m128i*)one + inputs;
+  int i;
+  __m128i diff;
+  do {
+    diff = _mm_setzero_si128();
+    for (i = 0; i < gates; i++) {
+      const int32_t* a = w->fan_in[i][0];
+      const int32_t* b = w->fan_in[i][1];
+      __m128i az = _mm_set_epi64x(zero[a[1]], zero[a[0]]);
+      __m128i ao = _mm_set_epi64x(one[a[1]], one[a[0]]);
+      __m128i bz = _mm_set_epi64x(zero[b[1]], zero[b[0]]);
+      __m128i bo = _mm_set_epi64x(one[b[1]], one[b[0]]);
+      __m128i nz = _mm_and_si128(ao, bo);
+      __m128i no = _mm_or_si128(az, bz);
+      diff = _mm_or_si128(diff, _mm_or_si128(_mm_xor_si128(nz, z[i]), _mm_xor_si128(no, o[i])));
+      z[i] = nz;
+      o[i] = no;
+    }
+  } while (!w->acyclic && _mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128())) != 0xFFFF);
+}
+
+__attribute__((target("avx2")))
+KERNEL void fixpoint_avx2(pattern_word* zero, pattern_word* one, const lane_wiring* w, int inputs, int gates) {
+  const long long* zb = (const long long*)zero;
+  const long long* ob = (const long long*)one;
+  __m256i* z = (__m256i*)zero + inputs;
+  __m256i* o = (__m256i*)one + inputs;
+  int i;
+  __m256i diff;
+  do {
+    diff = _mm256_setzero_si256();
+    for (i = 0; i < gates; i++) {
+      __m128i a = _mm_loadu_si128((const __m128i*)w->fan_in[i][0]);
+      __m128i b = _mm_loadu_si128((const __m128i*)w->fan_in[i][1]);
+      __m256i az = _mm256_i32gather_epi64(zb, a, 8);
+      __m256i ao = _mm256_i32gather_epi64(ob, a, 8);
+      __m256i bz = _mm256_i32gather_epi64(zb, b, 8);
+      __m256i bo = _mm256_i32gather_epi64(ob, b, 8);
+      __m256i nz = _mm256_and_si256(ao, bo);
+      __m256i no = _mm256_or_si256(az, bz);
+      diff = _mm256_or_si256(diff, _mm256_or_si256(_mm256_xor_si256(nz, z[i]), _mm256_xor_si256(no, o[i])));
+      z[i] = nz;
+      o[i] = no;
+    }
+  } while (!w->acyclic && !_mm256_testz_si256(diff, diff));
+}
+
+__attribute__((target("avx512f")))
+KERNEL void fixpoint_avx512(pattern_word* zero, pattern_word* one, const lane_wiring* w, int inputs, int gates) {
+  __m512i* z = (__m512i*)zero + inputs;
+  __m512i* o = (__m512i*)one + inputs;
+  int i;
+  __m512i diff;
+  do {
+    diff = _mm512_setzero_si512();
+    for (i = 0; i < gates; i++) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)w->fan_in[i][0]);
+      __m256i b = _mm256_loadu_si256((const __m256i*)w->fan_in[i][1]);
+      __m512i az = _mm512_i32gather_epi64(a, zero, 8);
+      __m512i ao = _mm512_i32gather_epi64(a, one, 8);
+      __m512i bz = _mm512_i32gather_epi64(b, zero, 8);
+      __m512i bo = _mm512_i32gather_epi64(b, one, 8);
+      __m512i nz = _mm512_and_si512(ao, bo);
+      __m512i no = _mm512_or_si512(az, bz);
+      diff = _mm512_or_si512(diff, _mm512_or_si512(_mm512_xor_si512(nz, z[i]), _mm512_xor_si512(no, o[i])));
+      z[i] = nz;
+      o[i] = no;
+    }
+  } while (!w->acyclic && _mm512_test_epi64_mask(diff, diff));
+}
+#endif
+
+/* Widest first; select_simd_engine picks the first one the CPU supports. */
+static const simd_engine simd_engines[] = {
+#if defined(__x86_64__) || defined(__i386__)
+  {"AVX-512", "avx512f", 8},
+  {"AVX2", "avx2", 4},
+  {"SSE2", "sse2", 2},
+#endif
+  {"scalar", NULL, 1}
+};
+
+#define NUM_SIMD_ENGINES ((int)(sizeof(simd_engines) / sizeof(simd_engine)))
+
+typedef struct circuit_state circuit_state;
+typedef struct rng_buffer rng_buffer;
+
+/* One instance of the sized kernels, with a fixpoint per SIMD engine in
+ * the order of simd_engines. The generic instance has zero sizes.
+ */
+typedef struct {
+  int inputs;
+  int gates;
+  int outputs;
+  void (*fixpoint[NUM_SIMD_ENGINES])(pattern_word* zero, pattern_word* one, const lane_wiring* w);
+  uint64_t (*output_cone)(const gene* dna);
+  int (*has_cycle)(const gene* dna);
+  uint64_t (*fanout_cone)(const gene* dna, uint64_t gates);
+  uint64_t (*live)(const gene* dna);
+  void (*eval_state)(circuit_state* s, const gene* dna);
+  void (*update_state)(circuit_state* s, const gene* dna, uint64_t rewired);
+  int (*score_state)(const circuit_state* s, const gene* dna, const goal_table* goal);
+  int (*draw_mutation)(sfmt_t* sfmt, gene* value);
+  int (*draw_mutation_bulk)(rng_buffer* r, gene* value);
+  int (*draw_mutation_philox)(const uint32_t key[2], uint32_t generation, uint32_t index, gene* value);
+} sized_kernels;
+
+static const sized_kernels* sized;  /* chosen by select_sized_kernels */
+
+int simd_supported(const simd_engine* e) {
+  if (e->isa == NULL) {
+    return 1;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (!strcmp(e->isa, "avx512f")) {
+    return __builtin_cpu_supports("avx512f");
+  } else if (!strcmp(e->isa, "avx2")) {
+    return __builtin_cpu_supports("avx2");
+  } else if (!strcmp(e->isa, "sse2")) {
+    return __builtin_cpu_supports("sse2");
+  }
+#endif
+  return 0;
+}
+
+const simd_engine* select_simd_engine() {
+  int i;
+  for (i = 0; i < NUM_SIMD_ENGINES; i++) {
+    if (simd_supported(&simd_engines[i])) {
+      return &simd_engines[i];
+    }
+  }
+  return &simd_engines[NUM_SIMD_ENGINES - 1];
+}
+
+static void eval_batch(const simd_engine* e, double* fitness, gene** dna, condensation** cond, int* index,
+                       int count, const goal_table* goal) {
+  pattern_word zero[MAX_SLOTS * MAX_LANES] __attribute__((aligned(64)));
+  pattern_word one[MAX_SLOTS * MAX_LANES] __attribute__((aligned(64)));
+  lane_wiring w;
+  int correct[MAX_LANES] = {0};
+  int l, b;
+
+  wire_lanes(&w, dna, cond, count, e->lanes);
+  w.acyclic = cond != NULL && cond[0]->acyclic;
+  w.condensed = cond != NULL && e->lanes == 1 ? cond[0] : NULL;
+  for (b = 0; b < PATTERN_WORDS; b++) {
+    init_lanes(zero, one, e->lanes, b);
+    sized->fixpoint[e - simd_engines](zero, one, &w);
+    score_lanes(correct, zero, one, &w, goal, b);
+  }
+  for (l = 0; l < count; l++) {
+    fitness[index[l]] = (double)correct[l] / (PATTERNS * params.outputs);
+  }
+}
+
+/* When `condensed` is set, each circuit is condensed first: acyclic
+ * circuits are batched together and settle in one pass, and cyclic ones
+ * are wired in condensation order (the scalar engine then iterates only
+ * inside cyclic components). At 12 gates the lanes converge within a few
+ * passes and condensing each circuit costs more than it saves, so it is
+ * off by default.
+ */
+void eval_population_simd(const simd_engine* e, double* fitness, gene** dna, int count, const goal_table* goal,
+                          int condensed) {
+  condensation cond[2][MAX_LANES];
+  condensation* conds[2][MAX_LANES];
+  gene* batch[2][MAX_LANES];
+  int index[2][MAX_LANES];
+  int size[2] = {0, 0};
+  int i, k, l;
+
+  for (k = 0; k < 2; k++) {
+    for (l = 0; l < MAX_LANES; l++) {
+      conds[k][l] = &cond[k][l];
+    }
+  }
+  for (i = 0; i < count; i++) {
+    k = 1;
+    if (condensed) {
+      condensation c;
+      condense_dna(dna[i], &c);
+      k = !c.acyclic;
+      cond[k][size[k]] = c;
+    }
+    batch[k][size[k]] = dna[i];
+    index[k][size[k]++] = i;
+    if (size[k] == e->lanes) {
+      eval_batch(e, fitness, batch[k], condensed ? conds[k] : NULL, index[k], size[k], goal);
+      size[k] = 0;
+    }
+  }
+  for (k = 0; k < 2; k++) {
+    if (size[k] > 0) {
+      eval_batch(e, fitness, batch[k], condensed ? conds[k] : NULL, index[k], size[k], goal);
+    }
+  }
+}
+
+double eval_dna_fitness(gene* dna, const goal_table* goal) {
+  double fitness;
+  eval_population_simd(&simd_engines[NUM_SIMD_ENGINES - 1], &fitness, &dna, 1, goal, CONDENSED_LANES);
+  return fitness;
+}
+
+/* Gates that can reach an output: the outputs' fan-in closure, grown one
+ * gate's fan-in mask at a time.
+ */
+KERNEL uint64_t output_cone_sized(const gene* dna, int inputs, int gates, int outputs) {
+  uint64_t fan_in[MAX_GATES];
+  int i;
+  memset(fan_in, 0, gates * sizeof(uint64_t));
+  for (i = 0; i < gates * INPUTS_PER_GATE; i++) {
+    if (dna[i] >= inputs) {
+      fan_in[i / INPUTS_PER_GATE] |= (uint64_t)1 << (dna[i] - inputs);
+    }
+  }
+  uint64_t cone = dna_outputs_sized(dna, inputs, gates, outputs);
+  uint64_t frontier = cone;
+  while (frontier) {
+    uint64_t reached = fan_in[__builtin_ctzll(frontier)] & ~cone;
+    frontier &= frontier - 1;
+    cone |= reached;
+    frontier |= reached;
+  }
+  return cone;
+}
+
+uint64_t output_cone(const gene* dna) {
+  return sized->output_cone(dna);
+}
+
+/* Same count as degree(n, 0), given the DNA's output cone. */
+int cone_degree(const gene* dna, uint64_t cone) {
+  return params.outputs + __builtin_popcountll(cone & ~dna_outputs(dna));
+}
+
+int dna_degree(const gene* dna) {
+  return cone_degree(dna, output_cone(dna));
+}
+
+/* Same answer as has_cycle: a depth-first search along fan-in genes that
+ * reports a cycle on reaching a gate still on the stack.
+ */
+KERNEL int dna_has_cycle_sized(const gene* dna, int inputs, int gates) {
+  int state[MAX_GATES];
+  int stack[MAX_GATES];
+  int next[MAX_GATES];
+  int stack_len = 0;
+  int i;
+
+  memset(state, 0, gates * sizeof(int));
+  for (i = 0; i < gates; i++) {
+    if (state[i]) {
+      continue;
+    }
+    state[i] = 1;
+    stack[0] = i;
+    next[0] = 0;
+    stack_len = 1;
+    while (stack_len > 0) {
+      int top = stack[stack_len - 1];
+      if (next[stack_len - 1] == INPUTS_PER_GATE) {
+        state[top] = 2;
+        stack_len--;
+        continue;
+      }
+      int address = dna[top * INPUTS_PER_GATE + next[stack_len - 1]++];
+      if (address < inputs) {
+        continue;
+      }
+      int g = address - inputs;
+      if (state[g] == 1) {
+        return 1;
+      }
+      if (state[g] == 0) {
+        state[g] = 1;
+        stack[stack_len] = g;
+        next[stack_len] = 0;
+        stack_len++;
+      }
+    }
+  }
+  return 0;
+}
+
+int dna_has_cycle(const gene* dna) {
+  return sized->has_cycle(dna);
+}
+
+/* Structural canonical form. Two genomes with the same canonical form
+ * describe the same circuit up to gate numbering, operand order and dead
+ * logic, so they have the same fitness, degree and cycle flag. Only the
+ * live gates (see condensation) are kept; a refined structural hash
+ * orders operands and roots, and gates are renumbered in depth-first
+ * order from the outputs. Unused gate genes are zero. Numbering is not
+ * guaranteed to be unique for circuits with symmetric parts, which only
+ * costs a missed match.
+ */
+static inline uint64_t mix_hash(uint64_t a, uint64_t b) {
+  uint64_t x = (a ^ (b * 0x9e3779b97f4a7c15ULL)) * 0xd6e8feb86659fd93ULL;
+  return x ^ (x >> 32);
+}
+
+void canonical_dna(const gene* dna, gene* canon) {
+  uint64_t closure[MAX_GATES];
+  uint64_t hash[MAX_SLOTS];
+  uint64_t prev[MAX_SLOTS];
+  int by_size[MAX_GATES];
+  int size_start[MAX_GATES + 3] = {0};
+  int label[MAX_GATES];
+  int order[MAX_GATES];
+  int stack[MAX_GATES * INPUTS_PER_GATE + 1];
+  int count = 0;
+  int i, k, r;
+
+  /* closure[g]: every gate g depends on, by Warshall's algorithm on
+   * bitmasks. The live gates are found from it as in condense_fan_in.
+   */
+  for (i = 0; i < params.gates; i++) {
+    closure[i] = 0;
+    for (k = 0; k < INPUTS_PER_GATE; k++) {
+      if (dna[i * INPUTS_PER_GATE + k] >= params.inputs) {
+        closure[i] |= (uint64_t)1 << (dna[i * INPUTS_PER_GATE + k] - params.inputs);
+      }
+    }
+  }
+  for (k = 0; k < params.gates; k++) {
+    for (i = 0; i < params.gates; i++) {
+      if ((closure[i] >> k) & 1) {
+        closure[i] |= closure[k];
+      }
+    }
+  }
+  uint64_t cyclic = 0;
+  for (i = 0; i < params.gates; i++) {
+    cyclic |= ((closure[i] >> i) & 1) << i;
+  }
+  uint64_t live = dna_outputs(dna) | cyclic;
+  uint64_t m;
+  for (m = live; m; m &= m - 1) {
+    live |= closure[__builtin_ctzll(m)];
+  }
+
+  /* A gate outside cycles depends on fewer gates than anything it
+   * feeds, so hashing in order of closure size is a topological pass.
+   * Gates on cycles read the previous round's hashes, which keeps the
+   * result independent of gate numbering, and get further rounds.
+   */
+  for (m = live; m; m &= m - 1) {
+    size_start[__builtin_popcountll(closure[__builtin_ctzll(m)]) + 2]++;
+  }
+  for (i = 2; i < params.gates + 3; i++) {
+    size_start[i] += size_start[i - 1];
+  }
+  for (m = live; m; m &= m - 1) {
+    int g = __builtin_ctzll(m);
+    by_size[size_start[__builtin_popcountll(closure[g]) + 1]++] = g;
+  }
+  int num_live = __builtin_popcountll(live);
+  for (i = 0; i < SLOTS; i++) {
+    hash[i] = mix_hash(i < params.inputs ? i + 1 : 0, 0);
+  }
+  int rounds = 1 + __builtin_popcountll(cyclic);
+  for (r = 0; r < rounds; r++) {
+    memcpy(prev, hash, SLOTS * sizeof(uint64_t));
+    for (i = 0; i < num_live; i++) {
+      int g = by_size[i];
+      int a = dna[g * INPUTS_PER_GATE];
+      int b = dna[g * INPUTS_PER_GATE + 1];
+      uint64_t ha = a >= params.inputs && ((cyclic >> (a - params.inputs)) & 1) ? prev[a] : hash[a];
+      uint64_t hb = b >= params.inputs && ((cyclic >> (b - params.inputs)) & 1) ? prev[b] : hash[b];
+      hash[params.inputs + g] = ha < hb ? mix_hash(ha, hb) : mix_hash(hb, ha);
+    }
+  }
+
+  for (i = 0; i < params.gates; i++) {
+    label[i] = -1;
+  }
+  int root = 0;
+  while (1) {
+    int start = -1;
+    if (root < params.outputs) {
+      start = dna_output_slot(dna[params.gates * INPUTS_PER_GATE + root++]) - params.inputs;
+    } else {
+      for (m = live; m; m &= m - 1) {
+        int g = __builtin_ctzll(m);
+        if (label[g] == -1 && (start == -1 || hash[params.inputs + g] < hash[params.inputs + start])) {
+          start = g;
+        }
+      }
+      if (start == -1) {
+        break;
+      }
+    }
+    int stack_len = 0;
+    stack[stack_len++] = start;
+    while (stack_len > 0) {
+      int g = stack[--stack_len];
+      if (label[g] != -1) {
+        continue;
+      }
+      label[g] = count;
+      order[count++] = g;
+      int a = dna[g * INPUTS_PER_GATE];
+      int b = dna[g * INPUTS_PER_GATE + 1];
+      if (hash[a] > hash[b]) {
+        int t = a;
+        a = b;
+        b = t;
+      }
+      if (b >= params.inputs) {
+        stack[stack_len++] = b - params.inputs;
+      }
+      if (a >= params.inputs) {
+        stack[stack_len++] = a - params.inputs;
+      }
+    }
+  }
+
+  memset(canon, 0, DNA_LENGTH * sizeof(gene));
+  for (i = 0; i < count; i++) {
+    int g = order[i];
+    int a = dna[g * INPUTS_PER_GATE];
+    int b = dna[g * INPUTS_PER_GATE + 1];
+    a = a < params.inputs ? a : params.inputs + label[a - params.inputs];
+    b = b < params.inputs ? b : params.inputs + label[b - params.inputs];
+    canon[i * INPUTS_PER_GATE] = a < b ? a : b;
+    canon[i * INPUTS_PER_GATE + 1] = a < b ? b : a;
+  }
+  for (i = 0; i < params.outputs; i++) {
+    int g = dna_output_slot(dna[params.gates * INPUTS_PER_GATE + i]) - params.inputs;
+    canon[params.gates * INPUTS_PER_GATE + i] = params.inputs + label[g];
+  }
+}
+
+/* Native kernels: a circuit is emitted as C that evaluates one block of
+ * patterns with dual-rail 64-bit words, gates ordered by condensation so
+ * acyclic logic is straight-line code and each cyclic component iterates
+ * to its fixpoint. The emitted function only depends on <stdint.h>:
+ *
+ *   uint64_t name(const uint64_t* zero, const uint64_t* one,
+ *                 uint64_t* out_zero, uint64_t* out_one, uint64_t mask);
+ *
+ * zero/one hold the input rails, out_zero/out_one receive the
+ * output rails, mask selects the valid patterns, and the return
+ * value marks the patterns for which every gate settled.
+ */
+typedef pattern_word (*circuit_kernel)(const pattern_word*, const pattern_word*, pattern_word*, pattern_word*, pattern_word);
+
+typedef struct {
+  void* handle;
+  int count;
+  circuit_kernel* kernels;
+} kernel_library;
+
+#define CODEGEN_CC "cc"
+#define CODEGEN_FLAGS "-O2 -shared -fPIC"
+
+static void emit_nand(FILE* f, const gene* dna, int g, const char* indent) {
+  int a = dna[g * INPUTS_PER_GATE];
+  int b = dna[g * INPUTS_PER_GATE + 1];
+  int s = params.inputs + g;
+  fprintf(f, "%sz%d = o%d & o%d; o%d = z%d | z%d;\n", indent, s, a, b, s, a, b);
+}
+
+void emit_circuit(FILE* f, const gene* dna, const char* name) {
+  condensation c;
+  condense_dna(dna, &c);
+  int i, s;
+
+  fprintf(f, "uint64_t %s(const uint64_t* zero, const uint64_t* one, uint64_t* out_zero, uint64_t* out_one, uint64_t mask) {\n", name);
+  for (i = 0; i < params.inputs; i++) {
+    fprintf(f, "  uint64_t z%d = zero[%d], o%d = one[%d];\n", i, i, i, i);
+  }
+  for (i = params.inputs; i < SLOTS; i++) {
+    if ((c.live >> (i - params.inputs)) & 1) {
+      fprintf(f, "  uint64_t z%d = mask, o%d = mask;\n", i, i);
+    }
+  }
+  if (!c.acyclic) {
+    fprintf(f, "  uint64_t z, o, diff;\n");
+  }
+  for (s = 0; s < c.num_sccs; s++) {
+    if (!((c.live >> c.order[c.scc_start[s]]) & 1)) {
+      continue;
+    }
+    if (!c.scc_cyclic[s]) {
+      emit_nand(f, dna, c.order[c.scc_start[s]], "  ");
+      continue;
+    }
+    fprintf(f, "  do {\n    diff = 0;\n");
+    for (i = c.scc_start[s]; i < c.scc_start[s + 1]; i++) {
+      int g = c.order[i];
+      int a = dna[g * INPUTS_PER_GATE];
+      int b = dna[g * INPUTS_PER_GATE + 1];
+      int slot = params.inputs + g;
+      fprintf(f, "    z = o%d & o%d; o = z%d | z%d;\n", a, b, a, b);
+      fprintf(f, "    diff |= (z ^ z%d) | (o ^ o%d); z%d = z; o%d = o;\n", slot, slot, slot, slot);
+    }
+    fprintf(f, "  } while (diff);\n");
+  }
+  for (i = 0; i < params.outputs; i++) {
+    int slot = dna_output_slot(dna[params.gates * INPUTS_PER_GATE + i]);
+    fprintf(f, "  out_zero[%d] = z%d; out_one[%d] = o%d;\n", i, slot, i, slot);
+  }
+  fprintf(f, "  return mask & ~(0");
+  for (i = params.inputs; i < SLOTS; i++) {
+    if ((c.live >> (i - params.inputs)) & 1) {
+      fprintf(f, " | (z%d & o%d)", i, i);
+    }
+  }
+  fprintf(f, ");\n}\n");
+}
+
+/* Writes a standalone source file evaluating `dna`, e.g. to hand an
+ * evolved champion to other tools. Returns 0 on success.
+ */
+int export_circuit(const char* path, const gene* dna, const char* name) {
+  FILE* f = fopen(path, "w");
+  if (f == NULL) {
+    return -1;
+  }
+  fprintf(f, "#include <stdint.h>\n\n");
+  emit_circuit(f, dna, name);
+  return fclose(f);
+}
+
+/* Unloads a library returned by compile_circuits. */
+void free_kernel_library(kernel_library* k) {
+  dlclose(k->handle);
+  free(k->kernels);
+  free(k);
+}
+
+/* Compiles `count` circuits into one shared object with the local C
+ * compiler and loads it. Returns NULL if any step fails.
+ */
+kernel_library* compile_circuits(gene** dna, int count) {
+  char dir[] = "/tmp/combinationalXXXXXX";
+  char src[64], lib[64], cmd[256], name[32];
+  kernel_library* k = NULL;
+  int i;
+  if (mkdtemp(dir) == NULL) {
+    return NULL;
+  }
+  sprintf(src, "%s/circuits.c", dir);
+  sprintf(lib, "%s/circuits.so", dir);
+  FILE* f = fopen(src, "w");
+  if (f != NULL) {
+    fprintf(f, "#include <stdint.h>\n\n");
+    for (i = 0; i < count; i++) {
+      sprintf(name, "circuit_%d", i);
+      emit_circuit(f, dna[i], name);
+    }
+    fclose(f);
+    sprintf(cmd, CODEGEN_CC " " CODEGEN_FLAGS " -o %s %s 2>/dev/null", lib, src);
+    void* handle = system(cmd) == 0 ? dlopen(lib, RTLD_NOW | RTLD_LOCAL) : NULL;
+    if (handle != NULL) {
+      k = (kernel_library*)malloc(sizeof(kernel_library));
+      k->handle = handle;
+      k->count = count;
+      k->kernels = (circuit_kernel*)malloc(sizeof(circuit_kernel) * count);
+      for (i = 0; i < count && k != NULL; i++) {
+        sprintf(name, "circuit_%d", i);
+        k->kernels[i] = (circuit_kernel)dlsym(handle, name);
+        if (k->kernels[i] == NULL) {
+          free_kernel_library(k);
+          k = NULL;
+        }
+      }
+    }
+  }
+  unlink(src);
+  unlink(lib);
+  rmdir(dir);
+  return k;
+}
+
+/* Evaluates block `block` of the input patterns, as eval_network_bitsliced
+ * does for networks.
+ */
+pattern_word eval_kernel_block(circuit_kernel kernel, dual_rail* output, int block) {
+  pattern_word zero[MAX_INPUTS], one[MAX_INPUTS];
+  pattern_word out_zero[MAX_OUTPUTS], out_one[MAX_OUTPUTS];
+  pattern_word mask = block_mask(params.inputs);
+  int i;
+  for (i = 0; i < params.inputs; i++) {
+    one[i] = input_pattern(i, params.inputs, block) & mask;
+    zero[i] = ~one[i] & mask;
+  }
+  pattern_word settled = kernel(zero, one, out_zero, out_one, mask);
+  for (i = 0; i < params.outputs; i++) {
+    output[i].zero = out_zero[i];
+    output[i].one = out_one[i];
+  }
+  return settled;
+}
+
+double eval_kernel_fitness(circuit_kernel kernel, const goal_table* goal) {
+  dual_rail output[MAX_OUTPUTS];
+  int correct = 0;
+  int b, i;
+  for (b = 0; b < PATTERN_WORDS; b++) {
+    pattern_word settled = eval_kernel_block(kernel, output, b);
+    for (i = 0; i < params.outputs; i++) {
+      correct += __builtin_popcountll(settled & ~(output[i].one ^ goal->expected[i][b]));
+    }
+  }
+  return (double)correct / (PATTERNS * params.outputs);
+}
+
+/* Signals kept between generations so that a mutated child only
+ * re-evaluates the fan-out cone of the gene that changed. Only the live
+ * gates (see condense_fan_in) are kept current: the others cannot change
+ * the fitness, so their signals go stale until a mutation makes them
+ * live again.
+ */
+struct circuit_state {
+  int valid;
+  uint64_t live;
+  uint64_t rewired;
+  int outputs_moved;
+  dual_rail signal[];  /* PATTERN_WORDS blocks of SLOTS signals */
+};
+
+#define STATE_BYTES (sizeof(circuit_state) + PATTERN_WORDS * SLOTS * sizeof(dual_rail))
+
+/* fan_out[g]: the gates reading gate g. */
+KERNEL void dna_fan_out(const gene* dna, uint64_t* fan_out, int inputs, int gates) {
+  int i;
+  for (i = 0; i < gates; i++) {
+    fan_out[i] = 0;
+  }
+  for (i = 0; i < gates * INPUTS_PER_GATE; i++) {
+    if (dna[i] >= inputs) {
+      fan_out[dna[i] - inputs] |= (uint64_t)1 << (i / INPUTS_PER_GATE);
+    }
+  }
+}
+
+KERNEL uint64_t fan_out_closure(const uint64_t* fan_out, uint64_t gates) {
+  uint64_t cone = gates;
+  uint64_t frontier = cone;
+  while (frontier) {
+    uint64_t reached = fan_out[__builtin_ctzll(frontier)] & ~cone;
+    frontier &= frontier - 1;
+    cone |= reached;
+    frontier |= reached;
+  }
+  return cone;
+}
+
+/* The live gates of condense_dna, without condensing: gates other than
+ * outputs that feed no remaining gate are dropped until none is left,
+ * which keeps exactly the gates with a path to an output or into a
+ * cycle.
+ */
+KERNEL uint64_t live_gates(const uint64_t* fan_out, uint64_t outputs, int gates) {
+  uint64_t live = gates == 64 ? ~(uint64_t)0 : ((uint64_t)1 << gates) - 1;
+  int dropped = 1;
+  while (dropped) {
+    uint64_t m;
+    dropped = 0;
+    for (m = live & ~outputs; m; m &= m - 1) {
+      int g = __builtin_ctzll(m);
+      if (!(fan_out[g] & live)) {
+        live &= ~((uint64_t)1 << g);
+        dropped = 1;
+      }
+    }
+  }
+  return live;
+}
+
+KERNEL uint64_t dna_live_sized(const gene* dna, int inputs, int gates, int outputs) {
+  uint64_t fan_out[MAX_GATES];
+  dna_fan_out(dna, fan_out, inputs, gates);
+  return live_gates(fan_out, dna_outputs_sized(dna, inputs, gates, outputs), gates);
+}
+
+uint64_t dna_live(const gene* dna) {
+  return sized->live(dna);
+}
+
+/* Gates whose value can depend on any gate in `gates`, including them. */
+KERNEL uint64_t fanout_cone_sized(const gene* dna, uint64_t gates, int num_inputs, int num_gates) {
+  uint64_t fan_out[MAX_GATES];
+  dna_fan_out(dna, fan_out, num_inputs, num_gates);
+  return fan_out_closure(fan_out, gates);
+}
+
+uint64_t fanout_cone(const gene* dna, uint64_t gates) {
+  return sized->fanout_cone(dna, gates);
+}
+
+/* Resets the gates in `gates` to INDETERMINATE and runs the ternary
+ * fixpoint over them; every other signal is held fixed.
+ */
+KERNEL void settle_gates(dual_rail* signal, const gene* dna, uint64_t gates, pattern_word mask, int inputs) {
+  uint64_t m;
+  for (m = gates; m; m &= m - 1) {
+    int g = __builtin_ctzll(m);
+    signal[inputs + g].zero = mask;
+    signal[inputs + g].one = mask;
+  }
+  pattern_word diff;
+  do {
+    diff = 0;
+    for (m = gates; m; m &= m - 1) {
+      int g = __builtin_ctzll(m);
+      dual_rail r = dual_nand(signal[dna[g * INPUTS_PER_GATE]], signal[dna[g * INPUTS_PER_GATE + 1]]);
+      diff |= (r.zero ^ signal[inputs + g].zero) | (r.one ^ signal[inputs + g].one);
+      signal[inputs + g] = r;
+    }
+  } while (diff);
+}
+
+KERNEL void eval_dna_state_sized(circuit_state* s, const gene* dna, int inputs, int gates, int outputs) {
+  pattern_word mask = block_mask(inputs);
+  int slots = inputs + gates;
+  int i, b;
+  s->live = dna_live_sized(dna, inputs, gates, outputs);
+  for (b = 0; b < PATTERN_BLOCKS(inputs); b++) {
+    for (i = 0; i < inputs; i++) {
+      s->signal[b * slots + i].one = input_pattern(i, inputs, b) & mask;
+      s->signal[b * slots + i].zero = ~s->signal[b * slots + i].one & mask;
+    }
+    settle_gates(s->signal + b * slots, dna, s->live, mask, inputs);
+  }
+  s->valid = 1;
+  s->rewired = 0;
+  s->outputs_moved = 0;
+}
+
+void eval_dna_state(circuit_state* s, const gene* dna) {
+  sized->eval_state(s, dna);
+}
+
+/* Re-evaluates s after the fan-in of the gates in `rewired` changed or
+ * the outputs moved. Live gates outside the rewired gates' fan-out cone
+ * see the same wiring as before and keep their signals; gates that only
+ * now became live are settled from scratch. Every fan-in of a live gate
+ * is live, so no gate that was live before reads a newly live one unless
+ * it was rewired.
+ */
+KERNEL void update_dna_state_sized(circuit_state* s, const gene* dna, uint64_t rewired,
+                                   int inputs, int gates, int outputs) {
+  uint64_t fan_out[MAX_GATES];
+  dna_fan_out(dna, fan_out, inputs, gates);
+  uint64_t live = live_gates(fan_out, dna_outputs_sized(dna, inputs, gates, outputs), gates);
+  uint64_t stale = (fan_out_closure(fan_out, rewired) | ~s->live) & live;
+  int b;
+  for (b = 0; b < PATTERN_BLOCKS(inputs); b++) {
+    settle_gates(s->signal + b * (inputs + gates), dna, stale, block_mask(inputs), inputs);
+  }
+  s->live = live;
+}
+
+void update_dna_state(circuit_state* s, const gene* dna, uint64_t rewired) {
+  sized->update_state(s, dna, rewired);
+}
+
+void settle_dna_state(circuit_state* s, const gene* dna) {
+  if (!s->valid) {
+    eval_dna_state(s, dna);
+  } else if (s->rewired || s->outputs_moved) {
+    update_dna_state(s, dna, s->rewired);
+  }
+  s->rewired = 0;
+  s->outputs_moved = 0;
+}
+
+/* Dead gates cannot decide whether a pattern settles: each one settles
+ * once its fan-ins do, and a fan-in that does not is a live gate or
+ * depends on one.
+ */
+KERNEL int score_dna_state_sized(const circuit_state* s, const gene* dna, const goal_table* goal,
+                                 int inputs, int gates, int outputs) {
+  int slots = inputs + gates;
+  int correct = 0;
+  int i, b;
+  for (b = 0; b < PATTERN_BLOCKS(inputs); b++) {
+    pattern_word unsettled = 0;
+    uint64_t m;
+    for (m = s->live; m; m &= m - 1) {
+      i = inputs + __builtin_ctzll(m);
+      unsettled |= s->signal[b * slots + i].zero & s->signal[b * slots + i].one;
+    }
+    pattern_word settled = block_mask(inputs) & ~unsettled;
+    for (i = 0; i < outputs; i++) {
+      pattern_word out = s->signal[b * slots + output_slot_sized(dna[gates * INPUTS_PER_GATE + i], inputs)].one;
+      correct += __builtin_popcountll(settled & ~(out ^ goal->expected[i][b]));
+    }
+  }
+  return correct;
+}
+
+int score_dna_state(const circuit_state* s, const gene* dna, const goal_table* goal) {
+  return sized->score_state(s, dna, goal);
+}
+
+typedef struct {
+  gene* DNA;
+  int DNA_length;
+  network* network;
+  double fitness;
+  circuit_state* state;
+  double score;
+  uint64_t cone;
+  int degree;
+  int cyclic;
+  int goal;
+} circuit;
+
+uint32_t rand_range(sfmt_t* sfmt, uint32_t min, uint32_t max)
+{
+    int r;
+    const uint32_t range = max - min;
+    const uint32_t buckets = UINT32_MAX / range;
+    const uint32_t limit = buckets * range;
+
+    do
+    {
+        r = sfmt_genrand_uint32(sfmt);
+    } while (r >= limit);
+
+    return min + (r / buckets);
+}
+
+void random_dna(sfmt_t* sfmt, circuit* c) {
+  int i;
+  for (i = 0; i < c->DNA_length; i++) {
+    c->DNA[i] = rand_range(sfmt, 0, params.gates + params.inputs);
+  }
+}
+
+/* Returns the gene a mutation would rewrite, or -1, storing its new
+ * value in `value` without touching any DNA.
+ */
+KERNEL int draw_mutation_sized(sfmt_t* sfmt, gene* value, int inputs, int gates, int outputs) {
+  if (sfmt_genrand_real1(sfmt) < params.mutation) {
+    int mutation_gate = rand_range(sfmt, 0, gates * INPUTS_PER_GATE + outputs);
+    *value = rand_range(sfmt, 0, gates + inputs);
+    return mutation_gate;
+  }
+  return -1;
+}
+
+int draw_mutation(sfmt_t* sfmt, gene* value) {
+  return sized->draw_mutation(sfmt, value);
+}
+
+/* Returns the gene that was rewritten, or -1. */
+int mutate(sfmt_t* sfmt, circuit* c) {
+  gene value;
+  int locus = draw_mutation(sfmt, &value);
+  if (locus >= 0) {
+    c->DNA[locus] = value;
+  }
+  return locus;
+}
+
+/* Bulk randomness for breeding: words come from sfmt_fill_array32 into a
+ * buffer refilled once it runs dry (about once a generation), from an
+ * SFMT state of its own since the fill path cannot be mixed with
+ * single draws. Ranges are reduced by multiply-shift with rejection
+ * (Lemire), with rejection thresholds that fold to constants in the
+ * sized kernels.
+ */
+#define RNG_WORDS ((params.circuits * 3 + SFMT_N32 + 3) / 4 * 4)
+#define MUTATION_THRESHOLD ((uint64_t)(params.mutation * 4294967296.0))
+
+struct rng_buffer {
+  sfmt_t sfmt;
+  uint32_t* words;
+  int size;
+  int next;
+};
+
+void init_rng_buffer(rng_buffer* r, sfmt_t* seed) {
+  uint32_t key[1] = {sfmt_genrand_uint32(seed)};
+  sfmt_init_by_array(&r->sfmt, key, 1);
+  r->size = RNG_WORDS;
+  r->words = (uint32_t*)aligned_alloc(16, r->size * sizeof(uint32_t));
+  r->next = r->size;
+}
+
+void free_rng_buffer(rng_buffer* r) {
+  free(r->words);
+}
+
+static inline uint32_t next_word(rng_buffer* r) {
+  if (r->next == r->size) {
+    sfmt_fill_array32(&r->sfmt, r->words, r->size);
+    r->next = 0;
+  }
+  return r->words[r->next++];
+}
+
+/* Uniform in [0, range); `reject` is (2^32 - range) % range. */
+static inline uint32_t bulk_range(rng_buffer* r, uint32_t range, uint32_t reject) {
+  uint64_t m = (uint64_t)next_word(r) * range;
+  while ((uint32_t)m < reject) {
+    m = (uint64_t)next_word(r) * range;
+  }
+  return (uint32_t)(m >> 32);
+}
+
+#define RANGE_REJECT(range) ((uint32_t)(((uint64_t)1 << 32) % (range)))
+#define LOCUS_REJECT RANGE_REJECT(DNA_LENGTH)
+#define SLOT_REJECT RANGE_REJECT(params.gates + params.inputs)
+
+void random_dna_bulk(rng_buffer* r, circuit* c) {
+  int i;
+  for (i = 0; i < c->DNA_length; i++) {
+    c->DNA[i] = bulk_range(r, params.gates + params.inputs, SLOT_REJECT);
+  }
+}
+
+KERNEL int draw_mutation_bulk_sized(rng_buffer* r, gene* value, int inputs, int gates, int outputs) {
+  if (next_word(r) < MUTATION_THRESHOLD) {
+    int length = gates * INPUTS_PER_GATE + outputs;
+    int mutation_gate = bulk_range(r, length, RANGE_REJECT(length));
+    *value = bulk_range(r, gates + inputs, RANGE_REJECT(gates + inputs));
+    return mutation_gate;
+  }
+  return -1;
+}
+
+int draw_mutation_bulk(rng_buffer* r, gene* value) {
+  return sized->draw_mutation_bulk(r, value);
+}
+
+/* Counter-based randomness: Philox4x32-10 turns a 128-bit counter and a
+ * 64-bit key into four independent words. Breeding keys it by the seed
+ * and the experiment and counts by (generation, circuit index, block),
+ * circuits of island k being numbered from k * circuits, so every
+ * circuit's draws can be computed on their own and a run does not depend
+ * on how work is spread over threads.
+ */
+static inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  int i;
+  for (i = 0; i < 10; i++) {
+    uint64_t p0 = (uint64_t)0xD2511F53 * c0;
+    uint64_t p1 = (uint64_t)0xCD9E8D57 * c2;
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t)p1;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t)p0;
+    k0 += 0x9E3779B9;
+    k1 += 0xBB67AE85;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/* The words of one circuit's draws in one generation. */
+typedef struct {
+  uint32_t key[2];
+  uint32_t counter[4];
+  uint32_t words[4];
+  int next;
+} philox_stream;
+
+#define PHILOX_INIT 0xFFFFFFFFu
+
+void open_philox(philox_stream* s, const uint32_t key[2], uint32_t generation, uint32_t index) {
+  s->key[0] = key[0];
+  s->key[1] = key[1];
+  s->counter[0] = generation;
+  s->counter[1] = index;
+  s->counter[2] = 0;
+  s->counter[3] = 0;
+  s->next = 4;
+}
+
+static inline uint32_t philox_word(philox_stream* s) {
+  if (s->next == 4) {
+    philox4x32(s->counter, s->key, s->words);
+    s->counter[2]++;
+    s->next = 0;
+  }
+  return s->words[s->next++];
+}
+
+static inline uint32_t philox_range(philox_stream* s, uint32_t range, uint32_t reject) {
+  uint64_t m = (uint64_t)philox_word(s) * range;
+  while ((uint32_t)m < reject) {
+    m = (uint64_t)philox_word(s) * range;
+  }
+  return (uint32_t)(m >> 32);
+}
+
+void random_dna_philox(const uint32_t key[2], uint32_t index, circuit* c) {
+  philox_stream s;
+  open_philox(&s, key, PHILOX_INIT, index);
+  int i;
+  for (i = 0; i < c->DNA_length; i++) {
+    c->DNA[i] = philox_range(&s, params.gates + params.inputs, SLOT_REJECT);
+  }
+}
+
+KERNEL int draw_mutation_philox_sized(const uint32_t key[2], uint32_t generation, uint32_t index, gene* value,
+                                      int inputs, int gates, int outputs) {
+  philox_stream s;
+  open_philox(&s, key, generation, index);
+  if (philox_word(&s) < MUTATION_THRESHOLD) {
+    int length = gates * INPUTS_PER_GATE + outputs;
+    int mutation_gate = philox_range(&s, length, RANGE_REJECT(length));
+    *value = philox_range(&s, gates + inputs, RANGE_REJECT(gates + inputs));
+    return mutation_gate;
+  }
+  return -1;
+}
+
+int draw_mutation_philox(const uint32_t key[2], uint32_t generation, uint32_t index, gene* value) {
+  return sized->draw_mutation_philox(key, generation, index, value);
+}
+
+/* Instances of the sized kernels: one per common size, with the sizes as
+ * constants, and the generic one reading params. select_sized_kernels
+ * picks the instance matching the run's sizes.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define SIZED_FIXPOINTS(name, num_inputs, num_gates) \
+  __attribute__((target("avx512f"))) \
+  static void fixpoint_avx512_##name(pattern_word* zero, pattern_word* one, const lane_wiring* w) { \
+    fixpoint_avx512(zero, one, w, num_inputs, num_gates); \
+  } \
+  __attribute__((target("avx2"))) \
+  static void fixpoint_avx2_##name(pattern_word* zero, pattern_word* one, const lane_wiring* w) { \
+    fixpoint_avx2(zero, one, w, num_inputs, num_gates); \
+  } \
+  static void fixpoint_sse2_##name(pattern_word* zero, pattern_word* one, const lane_wiring* w) { \
+    fixpoint_sse2(zero, one, w, num_inputs, num_gates); \
+  } \
+  static void fixpoint_scalar_##name(pattern_word* zero, pattern_word* one, const lane_wiring* w) { \
+    fixpoint_scalar(zero, one, w, num_inputs, num_gates); \
+  }
+#define SIZED_FIXPOINT_TABLE(name) \
+  {fixpoint_avx512_##name, fixpoint_avx2_##name, fixpoint_sse2_##name, fixpoint_scalar_##name}
+#else
+#define SIZED_FIXPOINTS(name, num_inputs, num_gates) \
+  static void fixpoint_scalar_##name(pattern_word* zero, pattern_word* one, const lane_wiring* w) { \
+    fixpoint_scalar(zero, one, w, num_inputs, num_gates); \
+  }
+#define SIZED_FIXPOINT_TABLE(name) {fixpoint_scalar_##name}
+#endif
+
+#define SIZED_KERNELS(name, num_inputs, num_gates, num_outputs) \
+  SIZED_FIXPOINTS(name, num_inputs, num_gates) \
+  static uint64_t output_cone_##name(const gene* dna) { \
+    return output_cone_sized(dna, num_inputs, num_gates, num_outputs); \
+  } \
+  static int dna_has_cycle_##name(const gene* dna) { \
+    return dna_has_cycle_sized(dna, num_inputs, num_gates); \
+  } \
+  static uint64_t fanout_cone_##name(const gene* dna, uint64_t gates) { \
+    return fanout_cone_sized(dna, gates, num_inputs, num_gates); \
+  } \
+  static uint64_t dna_live_##name(const gene* dna) { \
+    return dna_live_sized(dna, num_inputs, num_gates, num_outputs); \
+  } \
+  static void eval_dna_state_##name(circuit_state* s, const gene* dna) { \
+    eval_dna_state_sized(s, dna, num_inputs, num_gates, num_outputs); \
+  } \
+  static void update_dna_state_##name(circuit_state* s, const gene* dna, uint64_t rewired) { \
+    update_dna_state_sized(s, dna, rewired, num_inputs, num_gates, num_outputs); \
+  } \
+  static int score_dna_state_##name(const circuit_state* s, const gene* dna, const goal_table* goal) { \
+    return score_dna_state_sized(s, dna, goal, num_inputs, num_gates, num_outputs); \
+  } \
+  static int draw_mutation_##name(sfmt_t* sfmt, gene* value) { \
+    return draw_mutation_sized(sfmt, value, num_inputs, num_gates, num_outputs); \
+  } \
+  static int draw_mutation_bulk_##name(rng_buffer* r, gene* value) { \
+    return draw_mutation_bulk_sized(r, value, num_inputs, num_gates, num_outputs); \
+  } \
+  static int draw_mutation_philox_##name(const uint32_t key[2], uint32_t generation, uint32_t index, \
+                                         gene* value) { \
+    return draw_mutation_philox_sized(key, generation, index, value, num_inputs, num_gates, num_outputs); \
+  }
+
+#define SIZED_ENTRY(name, num_inputs, num_gates, num_outputs) \
+  {num_inputs, num_gates, num_outputs, SIZED_FIXPOINT_TABLE(name), output_cone_##name, dna_has_cycle_##name, \
+   fanout_cone_##name, dna_live_##name, eval_dna_state_##name, update_dna_state_##name, score_dna_state_##name, \
+   draw_mutation_##name, draw_mutation_bulk_##name, draw_mutation_philox_##name}
+
+SIZED_KERNELS(generic, params.inputs, params.gates, params.outputs)
+SIZED_KERNELS(4_8_1, 4, 8, 1)
+SIZED_KERNELS(4_12_1, 4, 12, 1)
+SIZED_KERNELS(4_16_1, 4, 16, 1)
+SIZED_KERNELS(4_24_1, 4, 24, 1)
+SIZED_KERNELS(4_32_1, 4, 32, 1)
+SIZED_KERNELS(3_16_6, 3, 16, 6)
+SIZED_KERNELS(3_16_7, 3, 16, 7)
+
+static const sized_kernels generic_kernels = SIZED_ENTRY(generic, 0, 0, 0);
+
+/* The default sizes, other gate counts for the modular goals, and the
+ * three-input goal sets. */
+static const sized_kernels sized_kernel_table[] = {
+  SIZED_ENTRY(4_8_1, 4, 8, 1),
+  SIZED_ENTRY(4_12_1, 4, 12, 1),
+  SIZED_ENTRY(4_16_1, 4, 16, 1),
+  SIZED_ENTRY(4_24_1, 4, 24, 1),
+  SIZED_ENTRY(4_32_1, 4, 32, 1),
+  SIZED_ENTRY(3_16_6, 3, 16, 6),
+  SIZED_ENTRY(3_16_7, 3, 16, 7),
+};
+
+#define NUM_SIZED_KERNELS ((int)(sizeof(sized_kernel_table) / sizeof(sized_kernels)))
+
+void select_sized_kernels() {
+  int i;
+  sized = &generic_kernels;
+  for (i = 0; i < NUM_SIZED_KERNELS; i++) {
+    const sized_kernels* k = &sized_kernel_table[i];
+    if (k->inputs == params.inputs && k->gates == params.gates && k->outputs == params.outputs) {
+      sized = k;
+    }
+  }
+}
+
+void create_circuit_network(circuit* c) {
+  c->network->num_gates = params.gates;
+  c->network->num_inputs = params.inputs;
+  c->network->num_outputs = params.outputs;
+
+  gate** gates = (gate**)malloc(sizeof(gate*) * c->network->num_gates);
+  gate** inputs = (gate**)malloc(sizeof(gate*) * c->network->num_inputs);
+  gate** output = (gate**)malloc(sizeof(gate*) * c->network->num_outputs);
+
+  int i;
+  for (i = 0; i < c->network->num_gates; i++) {
+    gates[i] = (gate*)malloc(sizeof(gate));
+    make_gate(gates[i], nand_g, 2);
+  }
+  for (i = 0; i < c->network->num_inputs; i++) {
+    inputs[i] = (gate*)malloc(sizeof(gate));
+    make_gate(inputs[i], input_g, 1);
+  }
+
+  c->network->gates = gates;
+  c->network->inputs = inputs;
+  c->network->output = output;
+  c->network->condensed = NULL;
+}
+
+void circuitize(circuit* c) {
+  int i, j;
+  for (i = 0; i < c->network->num_gates; i++) {
+    reset_gate(c->network->gates[i]);
+  }
+  for (i = 0; i < c->network->num_inputs; i++) {
+    reset_gate(c->network->inputs[i]);
+  }
+  free(c->network->condensed);
+  c->network->condensed = NULL;
+
+  int dna_pos = 0;
+  for (i = 0; i < params.gates; i++) {
+    for (j = 0; j < INPUTS_PER_GATE; j++) {
+      uint16_t address = c->DNA[dna_pos++];
+      if (address >= params.inputs) {
+        connect_gates(c->network->gates[address - params.inputs], c->network->gates[i]);
+      } else {
+        connect_gates(c->network->inputs[address], c->network->gates[i]);
+      }
+    }
+  }
+
+  for (i = 0; i < params.outputs; i++) {
+    uint16_t address = c->DNA[dna_pos++];
+    if (address >= params.inputs) {
+      c->network->output[i] = c->network->gates[address - params.inputs];
+    } else {
+      c->network->output[i] = c->network->gates[address];
+    }
+  }
+}
+
+/* Sets up c around genome storage owned by the caller. */
+void init_circuit(circuit* c, gene* genome) {
+  c->network = (network*)malloc(sizeof(network));
+  c->DNA_length = DNA_LENGTH;
+  c->DNA = genome;
+  c->state = NULL;
+#if INCREMENTAL
+  c->state = (circuit_state*)malloc(STATE_BYTES);
+  c->state->valid = 0;
+#endif
+  c->goal = -1;
+}
+
+void make_circuit(circuit* c) {
+  init_circuit(c, (gene*)malloc(sizeof(gene) * DNA_LENGTH));
+}
+
+/* All genomes of a population in one aligned block, a slot per circuit.
+ * A child that breeding leaves unmutated shares its parent's slot, and a
+ * shared slot is copied only when a mutation is written to it. Each
+ * circuit holds one reference, so a free slot is left whenever one is
+ * shared.
+ */
+typedef struct {
+  gene* block;
+  int* refs;
+  int* free_slots;
+  int num_free;
+} dna_arena;
+
+#define ARENA_BYTES ((params.circuits * DNA_LENGTH * sizeof(gene) + 63) / 64 * 64)
+
+void make_dna_arena(dna_arena* a) {
+  a->block = (gene*)aligned_alloc(64, ARENA_BYTES);
+  a->refs = (int*)malloc(params.circuits * sizeof(int));
+  a->free_slots = (int*)malloc(params.circuits * sizeof(int));
+  int i;
+  for (i = 0; i < params.circuits; i++) {
+    a->refs[i] = 0;
+    a->free_slots[i] = params.circuits - i - 1;
+  }
+  a->num_free = params.circuits;
+}
+
+void free_dna_arena(dna_arena* a) {
+  free(a->block);
+  free(a->refs);
+  free(a->free_slots);
+}
+
+static inline int genome_slot(const dna_arena* a, const gene* dna) {
+  return (int)((dna - a->block) / DNA_LENGTH);
+}
+
+gene* claim_genome(dna_arena* a) {
+  int slot = a->free_slots[--a->num_free];
+  a->refs[slot] = 1;
+  return a->block + slot * DNA_LENGTH;
+}
+
+static inline void release_genome(dna_arena* a, gene* dna) {
+  int slot = genome_slot(a, dna);
+  if (--a->refs[slot] == 0) {
+    a->free_slots[a->num_free++] = slot;
+  }
+}
+
+/* Points dst at src's genome instead of its own. */
+void share_genome(dna_arena* a, circuit* dst, circuit* src) {
+  release_genome(a, dst->DNA);
+  dst->DNA = src->DNA;
+  a->refs[genome_slot(a, src->DNA)]++;
+}
+
+/* Gives c a copy of its genome if it shares it, before a write. */
+void own_genome(dna_arena* a, circuit* c) {
+  if (a->refs[genome_slot(a, c->DNA)] > 1) {
+    gene* copy = claim_genome(a);
+    memcpy(copy, c->DNA, DNA_LENGTH * sizeof(gene));
+    release_genome(a, c->DNA);
+    c->DNA = copy;
+  }
+}
+
+/* Copies everything already known about src's DNA, but not the DNA. */
+void copy_description(circuit* dst, circuit* src) {
+  if (dst->state != NULL) {
+    memcpy(dst->state, src->state, STATE_BYTES);
+  }
+  dst->score = src->score;
+  dst->cone = src->cone;
+  dst->degree = src->degree;
+  dst->cyclic = src->cyclic;
+  dst->goal = src->goal;
+}
+
+/* Copies DNA together with everything already known about it. */
+void copy_circuit(circuit* dst, circuit* src) {
+  memcpy(dst->DNA, src->DNA, dst->DNA_length * sizeof(gene));
+  copy_description(dst, src);
+}
+
+/* Records that gene `locus` of c is about to be set to `value` (nothing
+ * to do for -1); c->DNA and what is known about it are still the
+ * parent's. A circuit whose DNA is untouched keeps its score and is not
+ * evaluated again until the goal changes.
+ *
+ * Returns 1 for a neutral mutation, which keeps the parent's score too:
+ * the gene is unchanged, or it rewires a gate outside the output cone of
+ * an acyclic parent without closing a cycle. The outputs and cone then
+ * stay the same and every gate still settles.
+ */
+int mark_mutated(circuit* c, int locus, gene value) {
+  if (locus < 0) {
+    return 0;
+  }
+  if (c->DNA[locus] == value) {
+    return c->goal != -1;
+  }
+  if (c->state != NULL && locus < params.gates * INPUTS_PER_GATE) {
+    c->state->rewired |= (uint64_t)1 << (locus / INPUTS_PER_GATE);
+  } else if (c->state != NULL) {
+    c->state->outputs_moved = 1;
+  }
+  if (c->goal != -1 && locus < params.gates * INPUTS_PER_GATE) {
+    int g = locus / INPUTS_PER_GATE;
+    int source = value;
+    if (!((c->cone >> g) & 1)) {
+      if (c->cyclic == -1) {
+        c->cyclic = dna_has_cycle(c->DNA);
+      }
+      if (!c->cyclic && (source < params.inputs ||
+                         !((fanout_cone(c->DNA, (uint64_t)1 << g) >> (source - params.inputs)) & 1))) {
+        return 1;
+      }
+    }
+  }
+  c->goal = -1;
+  return 0;
+}
+
+void free_gate(gate* g) {
+  free(g->inputs);
+  free(g->outputs);
+}
+
+void free_network(network* n) {
+  int i;
+  for (i = 0; i < n->num_gates; i++) {
+    free_gate(n->gates[i]);
+    free(n->gates[i]);
+  }
+  for (i = 0; i < n->num_inputs; i++) {
+    free_gate(n->inputs[i]);
+    free(n->inputs[i]);
+  }
+  free(n->gates);
+  free(n->inputs);
+  free(n->output);
+  free(n->condensed);
+}
+
+/* The fast engines read the DNA directly; only the reference path
+ * builds the gate graph.
+ */
+int circuit_degree(circuit* c) {
+#if REFERENCE_EVAL
+  return degree(c->network, 0);
+#else
+  return cone_degree(c->DNA, c->cone);
+#endif
+}
+
+int circuit_has_cycle(circuit* c) {
+#if REFERENCE_EVAL
+  return has_cycle(c->network);
+#else
+  return dna_has_cycle(c->DNA);
+#endif
+}
+
+/* The output cone, degree and cycle flag only depend on the DNA, so they
+ * are recomputed just when that has changed.
+ */
+static void describe_dna(circuit* c) {
+  c->cone = output_cone(c->DNA);
+  c->degree = circuit_degree(c);
+  c->cyclic = -1;
+}
+
+/* Scores c against goal `goal_index`. */
+void score_circuit(circuit* c, const goal_table* goals, void (**goal_fns)(int*, int*), int goal_index) {
+#if INCREMENTAL
+  (void)goal_fns;
+  settle_dna_state(c->state, c->DNA);
+  c->score = (double)score_dna_state(c->state, c->DNA, &goals[goal_index]) / (PATTERNS * params.outputs);
+#elif BITSLICED
+  (void)goal_fns;
+  c->score = eval_dna_fitness(c->DNA, &goals[goal_index]);
+#else
+  (void)goals;
+  circuitize(c);
+  c->score = eval_network_fitness_vector(c->network, goal_fns[goal_index]);
+#endif
+  if (c->goal == -1) {
+    describe_dna(c);
+  }
+  c->goal = goal_index;
+}
+
+void score_circuits_simd(const simd_engine* e, circuit** c, int count, const goal_table* goals, int goal_index) {
+  gene** dna = (gene**)malloc(count * sizeof(gene*));
+  double* fitness = (double*)malloc(count * sizeof(double));
+  int i;
+  for (i = 0; i < count; i++) {
+    dna[i] = c[i]->DNA;
+  }
+  eval_population_simd(e, fitness, dna, count, &goals[goal_index], CONDENSED_LANES);
+  for (i = 0; i < count; i++) {
+    c[i]->score = fitness[i];
+    if (c[i]->goal == -1) {
+      describe_dna(c[i]);
+    }
+    c[i]->goal = goal_index;
+  }
+  free(dna);
+  free(fitness);
+}
+
+/* Worker pool for scoring a generation. The pending circuits are split
+ * into one contiguous shard per thread, the calling thread taking the
+ * first. Scores only depend on each circuit, and everything that reads
+ * them across circuits runs afterwards on the calling thread, so the run
+ * is the same for any number of threads.
+ */
+typedef struct eval_pool eval_pool;
+
+typedef struct {
+  eval_pool* pool;
+  int index;
+} pool_worker_arg;
+
+struct eval_pool {
+  int num_threads;
+  pthread_t threads[MAX_THREADS];
+  pool_worker_arg args[MAX_THREADS];
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  int round;
+  int remaining;
+  int stop;
+
+  circuit** pending;
+  int count;
+  const goal_table* goals;
+  void (**goal_fns)(int*, int*);
+  int goal;
+#if SIMD && !INCREMENTAL
+  const simd_engine* engine;
+#endif
+};
+
+static void score_shard(eval_pool* p, int index) {
+  int begin = p->count * index / p->num_threads;
+  int end = p->count * (index + 1) / p->num_threads;
+#if SIMD && !INCREMENTAL
+  score_circuits_simd(p->engine, p->pending + begin, end - begin, p->goals, p->goal);
+#else
+  int i;
+  for (i = begin; i < end; i++) {
+    score_circuit(p->pending[i], p->goals, p->goal_fns, p->goal);
+  }
+#endif
+}
+
+static void* pool_worker(void* arg) {
+  eval_pool* p = ((pool_worker_arg*)arg)->pool;
+  int index = ((pool_worker_arg*)arg)->index;
+  int seen = 0;
+  pthread_mutex_lock(&p->lock);
+  while (1) {
+    while (p->round == seen && !p->stop) {
+      pthread_cond_wait(&p->start, &p->lock);
+    }
+    if (p->stop) {
+      break;
+    }
+    seen = p->round;
+    pthread_mutex_unlock(&p->lock);
+    score_shard(p, index);
+    pthread_mutex_lock(&p->lock);
+    if (--p->remaining == 0) {
+      pthread_cond_signal(&p->done);
+    }
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+/* threads <= 0 uses one thread per online core. */
+eval_pool* make_eval_pool(int threads) {
+  eval_pool* p = (eval_pool*)malloc(sizeof(eval_pool));
+  if (threads <= 0) {
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  p->num_threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+  p->round = 0;
+  p->remaining = 0;
+  p->stop = 0;
+#if SIMD && !INCREMENTAL
+  p->engine = select_simd_engine();
+#endif
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->start, NULL);
+  pthread_cond_init(&p->done, NULL);
+  int i;
+  for (i = 1; i < p->num_threads; i++) {
+    p->args[i].pool = p;
+    p->args[i].index = i;
+    pthread_create(&p->threads[i], NULL, pool_worker, &p->args[i]);
+  }
+  return p;
+}
+
+void score_circuits(eval_pool* p, circuit** pending, int count, const goal_table* goals, void (**goal_fns)(int*, int*), int goal) {
+  p->pending = pending;
+  p->count = count;
+  p->goals = goals;
+  p->goal_fns = goal_fns;
+  p->goal = goal;
+  if (p->num_threads == 1) {
+    score_shard(p, 0);
+    return;
+  }
+  pthread_mutex_lock(&p->lock);
+  p->remaining = p->num_threads - 1;
+  p->round++;
+  pthread_cond_broadcast(&p->start);
+  pthread_mutex_unlock(&p->lock);
+  score_shard(p, 0);
+  pthread_mutex_lock(&p->lock);
+  while (p->remaining > 0) {
+    pthread_cond_wait(&p->done, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+}
+
+void free_eval_pool(eval_pool* p) {
+  pthread_mutex_lock(&p->lock);
+  p->stop = 1;
+  pthread_cond_broadcast(&p->start);
+  pthread_mutex_unlock(&p->lock);
+  int i;
+  for (i = 1; i < p->num_threads; i++) {
+    pthread_join(p->threads[i], NULL);
+  }
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->start);
+  pthread_cond_destroy(&p->done);
+  free(p);
+}
+
+/* Fitness memo: a direct-mapped table keyed by the DNA and the goal it
+ * was scored against. A colliding insert evicts the older entry. With
+ * CANONICAL the key is the DNA's canonical form, so structurally equal
+ * circuits share one evaluation.
+ */
+typedef struct {
+  uint64_t hash;
+  double score;
+  int goal;
+  int degree;
+  int cyclic;
+  gene DNA[];
+} memo_entry;
+
+/* Entries are MEMO_ENTRY_BYTES apart, to hold DNA_LENGTH genes each. */
+#define MEMO_ENTRY_BYTES ((sizeof(memo_entry) + DNA_LENGTH * sizeof(gene) + 7) / 8 * 8)
+
+typedef struct {
+  char* entries;
+  long lookups;
+  long hits;
+} memo_table;
+
+static inline memo_entry* memo_slot(memo_table* m, uint64_t h) {
+  return (memo_entry*)(m->entries + (h & (MEMO_ENTRIES - 1)) * MEMO_ENTRY_BYTES);
+}
+
+memo_table* make_memo_table() {
+  memo_table* m = (memo_table*)malloc(sizeof(memo_table));
+  m->entries = (char*)malloc(MEMO_ENTRIES * MEMO_ENTRY_BYTES);
+  int i;
+  for (i = 0; i < MEMO_ENTRIES; i++) {
+    memo_slot(m, i)->goal = -1;
+  }
+  m->lookups = 0;
+  m->hits = 0;
+  return m;
+}
+
+void free_memo_table(memo_table* m) {
+  free(m->entries);
+  free(m);
+}
+
+uint64_t hash_dna(const gene* dna, int goal) {
+  uint64_t h = 0xcbf29ce484222325ULL ^ (uint64_t)goal;
+  int i;
+  for (i = 0; i < DNA_LENGTH; i++) {
+    h = (h ^ (uint64_t)dna[i]) * 0x100000001b3ULL;
+  }
+  return h ^ (h >> 29);
+}
+
+static inline const gene* memo_key(const circuit* c, gene* key) {
+#if CANONICAL
+  canonical_dna(c->DNA, key);
+  return key;
+#else
+  (void)key;
+  return c->DNA;
+#endif
+}
+
+/* Fills in c's score, degree and cycle flag (-1 if never asked for) if its DNA has been scored
+ * against `goal` before. Returns whether it had. The cone names c's own
+ * gates, so it is recomputed rather than shared.
+ */
+int memo_lookup(memo_table* m, circuit* c, int goal) {
+  gene buffer[MAX_DNA_LENGTH];
+  const gene* key = memo_key(c, buffer);
+  uint64_t h = hash_dna(key, goal);
+  memo_entry* e = memo_slot(m, h);
+  m->lookups++;
+  if (e->goal != goal || e->hash != h || memcmp(e->DNA, key, DNA_LENGTH * sizeof(gene)) != 0) {
+    return 0;
+  }
+  m->hits++;
+  c->score = e->score;
+  c->cone = output_cone(c->DNA);
+  c->degree = e->degree;
+  c->cyclic = e->cyclic;
+  c->goal = goal;
+  return 1;
+}
+
+void memo_insert(memo_table* m, circuit* c) {
+  gene buffer[MAX_DNA_LENGTH];
+  const gene* key = memo_key(c, buffer);
+  uint64_t h = hash_dna(key, c->goal);
+  memo_entry* e = memo_slot(m, h);
+  e->hash = h;
+  e->goal = c->goal;
+  memcpy(e->DNA, key, DNA_LENGTH * sizeof(gene));
+  e->score = c->score;
+  e->degree = c->degree;
+  e->cyclic = c->cyclic;
+}
+
+/* Cycle detection is only needed for the best circuits, so it is done
+ * on demand and remembered until the DNA changes.
+ */
+int circuit_cyclic(circuit* c) {
+  if (c->cyclic == -1) {
+#if REFERENCE_EVAL
+    circuitize(c);
+#endif
+    c->cyclic = circuit_has_cycle(c);
+  }
+  return c->cyclic;
+}
+
+/* Elite selection. Fitness only takes the values correct / (PATTERNS *
+ * outputs) minus the degree penalty per gate over the degree, so a circuit's
+ * fitness is identified by a small key, and the population is put in
+ * ascending order by a stable counting sort over the keys' ranks. Keys
+ * whose fitness compares equal share a rank, so ties keep their previous
+ * order as they did under qsort.
+ */
+#define FITNESS_LEVELS (PATTERNS * params.outputs + 1)
+#define FITNESS_KEYS (FITNESS_LEVELS * (params.gates + params.outputs))
+
+static double key_fitness(int key) {
+  double fitness = (double)(key % FITNESS_LEVELS) / (PATTERNS * params.outputs);
+  int excess = key / FITNESS_LEVELS;
+  if (excess > 0) {
+    fitness -= params.degree_penalty * excess;
+  }
+  return fitness;
+}
+
+static int key_compare(const void* k1, const void* k2) {
+  double f1 = key_fitness(*(const int*)k1);
+  double f2 = key_fitness(*(const int*)k2);
+  return f1 < f2 ? -1 : f1 > f2;
+}
+
+/* rank[key] orders the keys by fitness. */
+int* make_fitness_ranks() {
+  int* rank = (int*)malloc(sizeof(int) * FITNESS_KEYS);
+  int* keys = (int*)malloc(sizeof(int) * FITNESS_KEYS);
+  int i;
+  for (i = 0; i < FITNESS_KEYS; i++) {
+    keys[i] = i;
+  }
+  qsort(keys, FITNESS_KEYS, sizeof(int), key_compare);
+  int r = 0;
+  for (i = 0; i < FITNESS_KEYS; i++) {
+    if (i > 0 && key_compare(&keys[i - 1], &keys[i]) != 0) {
+      r++;
+    }
+    rank[keys[i]] = r;
+  }
+  free(keys);
+  return rank;
+}
+
+static inline int fitness_key(const circuit* c) {
+  int correct = (int)(c->score * (PATTERNS * params.outputs) + 0.5);
+  int excess = c->degree > params.degree ? c->degree - params.degree : 0;
+  return excess * FITNESS_LEVELS + correct;
+}
+
+void sort_population(circuit** pop, const int* rank) {
+  int* count = (int*)calloc(FITNESS_KEYS + 1, sizeof(int));
+  int* r = (int*)malloc(params.circuits * sizeof(int));
+  circuit** sorted = (circuit**)malloc(params.circuits * sizeof(circuit*));
+  int i;
+  for (i = 0; i < params.circuits; i++) {
+    r[i] = rank[fitness_key(pop[i])];
+    count[r[i] + 1]++;
+  }
+  for (i = 0; i < FITNESS_KEYS; i++) {
+    count[i + 1] += count[i];
+  }
+  for (i = 0; i < params.circuits; i++) {
+    sorted[count[r[i]]++] = pop[i];
+  }
+  memcpy(pop, sorted, params.circuits * sizeof(circuit*));
+  free(count);
+  free(r);
+  free(sorted);
+}
+
+/* One evolving population and everything time_to_perfect keeps for it
+ * across generations.
+ */
+typedef struct {
+  circuit* circuits;
+  circuit** pop;
+  circuit** pending;
+  dna_arena arena;
+  eval_pool* pool;
+#if MEMO
+  memo_table* memo;
+#endif
+  int* fitness_rank;
+  double max_fitness;
+  int max_degree;
+  int max_cyclic;
+  int mutations;
+  int neutral;
+#if RNG == RNG_BULK
+  rng_buffer rng;
+#elif RNG == RNG_PHILOX
+  uint32_t rng_key[2];
+  uint32_t rng_index;
+  uint32_t generation;
+#endif
+} population;
+
+/* `experiment` and `island` only choose the Philox streams. */
+population* make_population(sfmt_t* sfmt, int threads, int experiment, int island) {
+  population* p = (population*)aligned_alloc(16, (sizeof(population) + 15) / 16 * 16);
+  p->circuits = (circuit*)malloc(params.circuits * sizeof(circuit));
+  p->pop = (circuit**)malloc(params.circuits * sizeof(circuit*));
+  p->pending = (circuit**)malloc(params.circuits * sizeof(circuit*));
+  make_dna_arena(&p->arena);
+#if RNG == RNG_BULK
+  init_rng_buffer(&p->rng, sfmt);
+#elif RNG == RNG_PHILOX
+  (void)sfmt;
+  p->rng_key[0] = params.seed;
+  p->rng_key[1] = (uint32_t)experiment;
+  p->rng_index = (uint32_t)island * params.circuits;
+  p->generation = 0;
+#endif
+#if RNG != RNG_PHILOX
+  (void)experiment;
+  (void)island;
+#endif
+  int i;
+  for (i = 0; i < params.circuits; i++) {
+    p->pop[i] = &p->circuits[i];
+    init_circuit(&p->circuits[i], claim_genome(&p->arena));
+#if RNG == RNG_BULK
+    random_dna_bulk(&p->rng, &p->circuits[i]);
+#elif RNG == RNG_PHILOX
+    random_dna_philox(p->rng_key, p->rng_index + i, &p->circuits[i]);
+#else
+    random_dna(sfmt, &p->circuits[i]);
+#endif
+#if REFERENCE_EVAL
+    create_circuit_network(&p->circuits[i]);
+#endif
+  }
+  p->pool = make_eval_pool(threads);
+#if MEMO
+  p->memo = make_memo_table();
+#endif
+  p->fitness_rank = make_fitness_ranks();
+  p->max_fitness = 0.0;
+  p->max_degree = -1;
+  p->max_cyclic = -1;
+  p->mutations = 0;
+  p->neutral = 0;
+  return p;
+}
+
+/* Scores every circuit against goal `goal`, folds the results into the
+ * best-so-far record and sorts the population by fitness.
+ */
+void score_population(population* p, const goal_table* goals, void (**goal_fns)(int*, int*), int goal) {
+  circuit** pop = p->pop;
+  int num_pending = 0;
+  int i;
+  for (i = 0; i < params.circuits; i++) {
+    if (pop[i]->goal == goal) {
+      continue;
+    }
+#if MEMO
+    if (memo_lookup(p->memo, pop[i], goal)) {
+      continue;
+    }
+#endif
+    p->pending[num_pending++] = pop[i];
+  }
+  score_circuits(p->pool, p->pending, num_pending, goals, goal_fns, goal);
+  for (i = 0; i < params.circuits; i++) {
+    pop[i]->fitness = pop[i]->score;
+    int deg = pop[i]->degree;
+    if (deg > params.degree) {
+      pop[i]->fitness -= params.degree_penalty * (deg - params.degree);
+    }
+
+    if (pop[i]->fitness > p->max_fitness) {
+      p->max_fitness = pop[i]->fitness;
+      p->max_degree = deg;
+      p->max_cyclic = circuit_cyclic(pop[i]);
+    } else if (pop[i]->fitness == p->max_fitness) {
+      int cyclic = circuit_cyclic(pop[i]);
+      if (p->max_cyclic && !cyclic) {
+        p->max_cyclic = cyclic;
+      }
+      if (deg < p->max_degree) {
+        p->max_degree = deg;
+        p->max_cyclic = cyclic;
+      }
+    }
+  }
+#if MEMO
+  for (i = 0; i < num_pending; i++) {
+    memo_insert(p->memo, p->pending[i]);
+  }
+#endif
+  sort_population(pop, p->fitness_rank);
+}
+
+/* The RNG layer for breeding: the shared SFMT stream as published
+ * results used, bulk SFMT draws, or Philox keyed by circuit position.
+ */
+static inline int breed_mutation(population* p, sfmt_t* sfmt, int index, gene* value) {
+#if RNG == RNG_BULK
+  (void)sfmt;
+  (void)index;
+  return draw_mutation_bulk(&p->rng, value);
+#elif RNG == RNG_PHILOX
+  (void)sfmt;
+  return draw_mutation_philox(p->rng_key, p->generation, p->rng_index + index, value);
+#else
+  (void)p;
+  (void)index;
+  return draw_mutation(sfmt, value);
+#endif
+}
+
+/* Mutates circuit i of a population, counting the mutations that happen
+ * and how many of them are neutral. Its genome is copied only if it is
+ * shared and the mutation changes it.
+ */
+static inline void breed_child(population* p, sfmt_t* sfmt, int i) {
+  circuit* c = p->pop[i];
+  gene value;
+  int locus = breed_mutation(p, sfmt, i, &value);
+  if (locus < 0) {
+    return;
+  }
+  p->mutations++;
+  p->neutral += mark_mutated(c, locus, value);
+  if (c->DNA[locus] != value) {
+    own_genome(&p->arena, c);
+    c->DNA[locus] = value;
+  }
+}
+
+/* Replaces the elite worst circuits by mutated copies of the best and
+ * mutates the middle of the population.
+ */
+void breed_population(population* p, sfmt_t* sfmt) {
+  circuit** pop = p->pop;
+  int i;
+  p->mutations = 0;
+  p->neutral = 0;
+  for (i = 0; i < params.circuits - params.elite - 1; i++) {
+    if (i < params.elite) {
+      share_genome(&p->arena, pop[i], pop[params.circuits - i - 1]);
+      copy_description(pop[i], pop[params.circuits - i - 1]);
+    }
+    breed_child(p, sfmt, i);
+  }
+#if RNG == RNG_PHILOX
+  p->generation++;
+#endif
+}
+
+static int hash_compare(const void* h1, const void* h2) {
+  uint64_t a = *(const uint64_t*)h1;
+  uint64_t b = *(const uint64_t*)h2;
+  return (a > b) - (a < b);
+}
+
+/* Number of structurally distinct circuits in the population, told
+ * apart by the hash of their canonical forms.
+ */
+int distinct_circuits(const population* p) {
+  uint64_t* hashes = (uint64_t*)malloc(params.circuits * sizeof(uint64_t));
+  gene canon[MAX_DNA_LENGTH];
+  int i;
+  for (i = 0; i < params.circuits; i++) {
+    canonical_dna(p->pop[i]->DNA, canon);
+    hashes[i] = hash_dna(canon, 0);
+  }
+  qsort(hashes, params.circuits, sizeof(uint64_t), hash_compare);
+  int distinct = 1;
+  for (i = 1; i < params.circuits; i++) {
+    distinct += hashes[i] != hashes[i - 1];
+  }
+  free(hashes);
+  return distinct;
+}
+
+/* Percentage of the last generation's mutations that were neutral. */
+double neutral_rate(const population* p) {
+  return p->mutations ? 100.0 * p->neutral / p->mutations : 0.0;
+}
+
+void free_population(population* p) {
+  int i;
+  for (i = 0; i < params.circuits; i++) {
+#if REFERENCE_EVAL
+    free_network(p->circuits[i].network);
+#endif
+    free(p->circuits[i].network);
+    free(p->circuits[i].state);
+  }
+  free_dna_arena(&p->arena);
+#if RNG == RNG_BULK
+  free_rng_buffer(&p->rng);
+#endif
+  free(p->circuits);
+  free(p->pop);
+  free(p->pending);
+  free(p->fitness_rank);
+  free_eval_pool(p->pool);
+#if MEMO
+  free_memo_table(p->memo);
+#endif
+  free(p);
+}
+
+/* Island model: ISLANDS populations evolve on their own threads and every
+ * MIGRATION_INTERVAL generations send copies of their MIGRANTS best
+ * genomes to their neighbours in TOPOLOGY. Each directed link is a
+ * single-producer single-consumer ring; a full ring drops the migrant
+ * instead of waiting. Arrivals replace the weakest surviving circuits
+ * after breeding. The first island to reach fitness 1.0 stops them all.
+ * Migration timing depends on thread scheduling, so only a single
+ * island, which has no neighbours, is reproducible.
+ */
+typedef struct {
+  gene genomes[MIGRATION_SLOTS][MAX_DNA_LENGTH];
+  atomic_uint head;
+  atomic_uint tail;
+} migration_ring;
+
+int ring_push(migration_ring* r, const gene* dna) {
+  unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+  if (tail - head == MIGRATION_SLOTS) {
+    return 0;
+  }
+  memcpy(r->genomes[tail % MIGRATION_SLOTS], dna, DNA_LENGTH * sizeof(gene));
+  atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+  return 1;
+}
+
+int ring_pop(migration_ring* r, gene* dna) {
+  unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+  if (head == tail) {
+    return 0;
+  }
+  memcpy(dna, r->genomes[head % MIGRATION_SLOTS], DNA_LENGTH * sizeof(gene));
+  atomic_store_explicit(&r->head, head + 1, memory_order_release);
+  return 1;
+}
+
+/* Overwrites c with an arriving genome, which must then be evaluated
+ * from scratch.
+ */
+void replace_genome(population* p, circuit* c, const gene* dna) {
+  own_genome(&p->arena, c);
+  memcpy(c->DNA, dna, DNA_LENGTH * sizeof(gene));
+  c->goal = -1;
+  if (c->state != NULL) {
+    c->state->valid = 0;
+  }
+}
+
+#if ISLANDS > 0 || PROCESSES > 0
+/* Whether `from` sends migrants to `to` among `count` islands. */
+static int linked(int from, int to, int count) {
+  if (from == to) {
+    return 0;
+  }
+#if TOPOLOGY == TOPOLOGY_RING
+  return to == (from + 1) % count;
+#else
+  (void)count;
+  return 1;
+#endif
+}
+#endif
+
+#if ISLANDS > 0
+typedef struct island_model island_model;
+
+typedef struct {
+  island_model* model;
+  int index;
+  sfmt_t sfmt;
+  population* p;
+  int reached;
+} island;
+
+struct island_model {
+  island islands[ISLANDS];
+  migration_ring links[ISLANDS][ISLANDS];
+  const goal_table* goals;
+  void (**goal_fns)(int*, int*);
+  int num_goals;
+  atomic_int stop;
+  FILE* log;
+};
+
+static void* run_island(void* arg) {
+  island* is = (island*)arg;
+  island_model* m = is->model;
+  population* p = is->p;
+  gene migrant[MAX_DNA_LENGTH];
+  int current_goal = 0;
+  int i, k, j;
+  for (j = 0; !atomic_load_explicit(&m->stop, memory_order_relaxed); j++) {
+    if (j != 0 && j % params.epoch == 0) {
+      current_goal++;
+      current_goal %= m->num_goals;
+    }
+    score_population(p, m->goals, m->goal_fns, current_goal);
+    if (p->max_fitness == 1.0) {
+      is->reached = j;
+      atomic_store(&m->stop, 1);
+      break;
+    }
+    if (j != 0 && j % MIGRATION_INTERVAL == 0) {
+      for (k = 0; k < ISLANDS; k++) {
+        if (!linked(is->index, k, ISLANDS)) {
+          continue;
+        }
+        for (i = 0; i < MIGRANTS; i++) {
+          ring_push(&m->links[is->index][k], p->pop[params.circuits - 1 - i]->DNA);
+        }
+      }
+    }
+    breed_population(p, &is->sfmt);
+    int arrived = 0;
+    for (k = 0; k < ISLANDS; k++) {
+      if (!linked(k, is->index, ISLANDS)) {
+        continue;
+      }
+      while (arrived < params.circuits - 2 * params.elite - 1 && ring_pop(&m->links[k][is->index], migrant)) {
+        replace_genome(p, p->pop[params.elite + arrived++], migrant);
+      }
+    }
+    if (is->index == 0 && (j + 1) % params.update_interval == 0) {
+      fprintf(m->log, "%d: %f %f (effective gates: %d; %s; neutral: %.1f%%; distinct: %d)\n", j + 1, p->pop[params.circuits-1]->fitness, p->max_fitness, p->max_degree, (p->max_cyclic ? "cyclic" : "acyclic"), neutral_rate(p), distinct_circuits(p));
+    }
+  }
+  return NULL;
+}
+
+/* Returns the generation at which the first island reached 1.0. */
+int evolve_islands(sfmt_t* sfmt, int experiment, const goal_table* goals, void (**goal_fns)(int*, int*), int num_goals, FILE* log) {
+  island_model* m = (island_model*)malloc(sizeof(island_model));
+  pthread_t threads[ISLANDS];
+  m->goals = goals;
+  m->goal_fns = goal_fns;
+  m->num_goals = num_goals;
+  m->log = log;
+  atomic_init(&m->stop, 0);
+  int i, k;
+  for (i = 0; i < ISLANDS; i++) {
+    for (k = 0; k < ISLANDS; k++) {
+      atomic_init(&m->links[i][k].head, 0);
+      atomic_init(&m->links[i][k].tail, 0);
+    }
+  }
+  for (i = 0; i < ISLANDS; i++) {
+    island* is = &m->islands[i];
+    uint32_t key[2] = {sfmt_genrand_uint32(sfmt), (uint32_t)i};
+    sfmt_init_by_array(&is->sfmt, key, 2);
+    is->model = m;
+    is->index = i;
+    is->reached = -1;
+    is->p = make_population(&is->sfmt, 1, experiment, i);
+  }
+  for (i = 0; i < ISLANDS; i++) {
+    pthread_create(&threads[i], NULL, run_island, &m->islands[i]);
+  }
+  int reached = -1;
+  int winner = 0;
+  for (i = 0; i < ISLANDS; i++) {
+    pthread_join(threads[i], NULL);
+    if (m->islands[i].reached >= 0 && (reached == -1 || m->islands[i].reached < reached)) {
+      reached = m->islands[i].reached;
+      winner = i;
+    }
+  }
+  fprintf(log, "Island %d of %d reached 1.0\n", winner + 1, ISLANDS);
+#if EXPORT_CHAMPION
+  export_circuit(CHAMPION_PATH, m->islands[winner].p->pop[params.circuits - 1]->DNA, "champion");
+#endif
+  for (i = 0; i < ISLANDS; i++) {
+    free_population(m->islands[i].p);
+  }
+  free(m);
+  return reached;
+}
+#endif
+
+#if PROCESSES > 0
+/* Process islands: PROCESSES worker processes each evolve one island of
+ * the experiment and talk to the coordinating parent over a Unix domain
+ * socket pair. Messages are fixed-size farm_message packets carrying
+ * packed DNA, so the same protocol could cross machines. Workers send
+ * their best genomes as migrants every MIGRATION_INTERVAL generations;
+ * the coordinator forwards them along TOPOLOGY, dropping any a busy
+ * worker cannot take. The first worker to reach fitness 1.0 reports DONE,
+ * the coordinator sends STOP to the rest, and every worker answers with
+ * its best fitness, degree and generation count before exiting. A worker
+ * that hangs up or exits without reporting is counted as failed.
+ */
+enum {
+  MSG_MIGRANT,
+  MSG_DONE,
+  MSG_STOP,
+  MSG_RESULT
+};
+
+typedef struct {
+  int32_t type;
+  int32_t island;
+  int32_t generation;
+  int32_t degree;
+  int32_t cyclic;
+  double fitness;
+  gene DNA[MAX_DNA_LENGTH];
+} farm_message;
+
+static void send_message(int fd, int type, int island, int generation, const population* p, const gene* dna) {
+  farm_message msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.type = type;
+  msg.island = island;
+  msg.generation = generation;
+  if (p != NULL) {
+    msg.fitness = p->max_fitness;
+    msg.degree = p->max_degree;
+    msg.cyclic = p->max_cyclic;
+  }
+  if (dna != NULL) {
+    memcpy(msg.DNA, dna, DNA_LENGTH * sizeof(gene));
+  }
+  send(fd, &msg, sizeof(msg), MSG_NOSIGNAL);
+}
+
+static void run_process_island(int fd, int index, uint32_t seed, int experiment, const goal_table* goals,
+                               void (**goal_fns)(int*, int*), int num_goals) {
+  sfmt_t sfmt;
+  uint32_t key[2] = {seed, (uint32_t)index};
+  sfmt_init_by_array(&sfmt, key, 2);
+  population* p = make_population(&sfmt, 1, experiment, index);
+  farm_message msg;
+  int current_goal = 0;
+  int i, j;
+  for (j = 0; ; j++) {
+    if (j != 0 && j % params.epoch == 0) {
+      current_goal++;
+      current_goal %= num_goals;
+    }
+    score_population(p, goals, goal_fns, current_goal);
+    if (p->max_fitness == 1.0) {
+      send_message(fd, MSG_DONE, index, j, p, p->pop[params.circuits - 1]->DNA);
+      break;
+    }
+    if (j != 0 && j % MIGRATION_INTERVAL == 0) {
+      for (i = 0; i < MIGRANTS; i++) {
+        send_message(fd, MSG_MIGRANT, index, j, NULL, p->pop[params.circuits - 1 - i]->DNA);
+      }
+    }
+    breed_population(p, &sfmt);
+    int arrived = 0;
+    int stop = 0;
+    while (!stop && recv(fd, &msg, sizeof(msg), MSG_DONTWAIT) == sizeof(msg)) {
+      if (msg.type == MSG_STOP) {
+        stop = 1;
+      } else if (msg.type == MSG_MIGRANT && arrived < params.circuits - 2 * params.elite - 1) {
+        replace_genome(p, p->pop[params.elite + arrived++], msg.DNA);
+      }
+    }
+    if (stop) {
+      send_message(fd, MSG_RESULT, index, j + 1, p, NULL);
+      break;
+    }
+  }
+  free_population(p);
+}
+
+/* Returns the generation at which the first process reached 1.0, and
+ * exits if every worker failed before that.
+ */
+int evolve_processes(sfmt_t* sfmt, int experiment, const goal_table* goals, void (**goal_fns)(int*, int*), int num_goals, FILE* log) {
+  int fds[PROCESSES];
+  pid_t pids[PROCESSES];
+  uint32_t seed = sfmt_genrand_uint32(sfmt);
+  int i, k;
+  fflush(log);
+  fflush(stdout);
+  for (i = 0; i < PROCESSES; i++) {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair) != 0) {
+      perror("socketpair");
+      exit(1);
+    }
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      for (k = 0; k < i; k++) {
+        close(fds[k]);
+      }
+      close(pair[0]);
+      run_process_island(pair[1], i, seed, experiment, goals, goal_fns, num_goals);
+      close(pair[1]);
+      _exit(0);
+    }
+    close(pair[1]);
+    fds[i] = pair[0];
+  }
+
+  farm_message results[PROCESSES];
+  int finished[PROCESSES] = {0};
+  int failed[PROCESSES] = {0};
+  int remaining = PROCESSES;
+  memset(results, 0, sizeof(results));
+  int winner = -1;
+  struct pollfd polls[PROCESSES];
+  farm_message msg;
+  while (remaining > 0) {
+    for (i = 0; i < PROCESSES; i++) {
+      polls[i].fd = finished[i] ? -1 : fds[i];
+      polls[i].events = POLLIN;
+    }
+    if (poll(polls, PROCESSES, -1) < 0) {
+      continue;
+    }
+    for (i = 0; i < PROCESSES; i++) {
+      if (finished[i] || !(polls[i].revents & (POLLIN | POLLHUP))) {
+        continue;
+      }
+      if (recv(fds[i], &msg, sizeof(msg), 0) != sizeof(msg)) {
+        failed[i] = 1;
+        finished[i] = 1;
+        remaining--;
+        continue;
+      }
+      if (msg.type == MSG_MIGRANT) {
+        for (k = 0; k < PROCESSES; k++) {
+          if (!finished[k] && linked(i, k, PROCESSES)) {
+            send(fds[k], &msg, sizeof(msg), MSG_DONTWAIT | MSG_NOSIGNAL);
+          }
+        }
+        continue;
+      }
+      results[i] = msg;
+      finished[i] = 1;
+      remaining--;
+      if (msg.type == MSG_DONE && winner == -1) {
+        winner = i;
+        msg.type = MSG_STOP;
+        for (k = 0; k < PROCESSES; k++) {
+          if (!finished[k] && send(fds[k], &msg, sizeof(msg), MSG_NOSIGNAL) != sizeof(msg)) {
+            failed[k] = 1;
+            finished[k] = 1;
+            remaining--;
+          }
+        }
+      }
+    }
+  }
+  int num_failed = 0;
+  for (i = 0; i < PROCESSES; i++) {
+    int status;
+    close(fds[i]);
+    if (waitpid(pids[i], &status, 0) != pids[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed[i] = 1;
+    }
+    num_failed += failed[i];
+  }
+
+  for (i = 0; i < PROCESSES; i++) {
+    if (failed[i]) {
+      fprintf(log, "Process %d: failed\n", i + 1);
+      continue;
+    }
+    fprintf(log, "Process %d: %f after %d generations (effective gates: %d; %s)%s\n", i + 1, results[i].fitness,
+            results[i].generation, results[i].degree, (results[i].cyclic ? "cyclic" : "acyclic"),
+            i == winner ? " *" : "");
+  }
+  if (num_failed > 0) {
+    fprintf(stderr, "%d of %d worker processes failed\n", num_failed, PROCESSES);
+  }
+  if (winner < 0) {
+    fprintf(stderr, "no worker process reached 1.0\n");
+    exit(1);
+  }
+#if EXPORT_CHAMPION
+  if (winner >= 0) {
+    export_circuit(CHAMPION_PATH, results[winner].DNA, "champion");
+  }
+#endif
+  return results[winner].generation;
+}
+#endif
+
+/* Steady-state mode: workers repeatedly copy a random member of a shared
+ * pool of the elite best circuits, mutate and score the copy, and put it
+ * in place of the pool's worst member if it is fitter. There is no
+ * generation barrier; the goal switches every epoch * circuits
+ * children, at which point the pool is rescored under its lock. Neutral
+ * children keep their parent's score and are not counted as evaluations.
+ * Only one worker makes the run reproducible.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  circuit* members;
+  int worst;
+  long children;
+  long evaluations;
+  int goal;
+  int stop;
+  double max_fitness;
+  int max_degree;
+  int max_cyclic;
+  const goal_table* goals;
+  void (**goal_fns)(int*, int*);
+  int num_goals;
+  FILE* log;
+} elite_pool;
+
+typedef struct {
+  elite_pool* pool;
+  sfmt_t sfmt;
+} steady_worker;
+
+static double penalized_fitness(const circuit* c) {
+  double fitness = c->score;
+  if (c->degree > params.degree) {
+    fitness -= params.degree_penalty * (c->degree - params.degree);
+  }
+  return fitness;
+}
+
+static void find_worst(elite_pool* e) {
+  int i;
+  e->worst = 0;
+  for (i = 1; i < params.elite; i++) {
+    if (e->members[i].fitness < e->members[e->worst].fitness) {
+      e->worst = i;
+    }
+  }
+}
+
+/* Same tie-breaking as score_population. */
+static void track_best(elite_pool* e, circuit* c) {
+  if (c->fitness > e->max_fitness) {
+    e->max_fitness = c->fitness;
+    e->max_degree = c->degree;
+    e->max_cyclic = circuit_cyclic(c);
+  } else if (c->fitness == e->max_fitness) {
+    int cyclic = circuit_cyclic(c);
+    if (e->max_cyclic && !cyclic) {
+      e->max_cyclic = cyclic;
+    }
+    if (c->degree < e->max_degree) {
+      e->max_degree = c->degree;
+      e->max_cyclic = cyclic;
+    }
+  }
+}
+
+static void* run_steady_worker(void* arg) {
+  steady_worker* w = (steady_worker*)arg;
+  elite_pool* e = w->pool;
+  circuit child;
+  make_circuit(&child);
+#if REFERENCE_EVAL
+  create_circuit_network(&child);
+#endif
+  int i;
+  pthread_mutex_lock(&e->lock);
+  while (!e->stop) {
+    copy_circuit(&child, &e->members[rand_range(&w->sfmt, 0, params.elite)]);
+    int goal = e->goal;
+    pthread_mutex_unlock(&e->lock);
+
+    gene value;
+    int locus = draw_mutation(&w->sfmt, &value);
+    int neutral = 0;
+    if (locus >= 0) {
+      neutral = mark_mutated(&child, locus, value);
+      child.DNA[locus] = value;
+      if (!neutral) {
+        score_circuit(&child, e->goals, e->goal_fns, goal);
+      }
+      child.fitness = penalized_fitness(&child);
+    }
+
+    pthread_mutex_lock(&e->lock);
+    if (locus < 0 || e->stop) {
+      continue;
+    }
+    e->children++;
+    e->evaluations += !neutral;
+    if (goal == e->goal) {
+      track_best(e, &child);
+      if (child.fitness > e->members[e->worst].fitness) {
+        copy_circuit(&e->members[e->worst], &child);
+        e->members[e->worst].fitness = child.fitness;
+        find_worst(e);
+      }
+    }
+    if (e->max_fitness == 1.0) {
+      e->stop = 1;
+      break;
+    }
+    if (e->children % ((long)params.epoch * params.circuits) == 0) {
+      e->goal = (e->goal + 1) % e->num_goals;
+      for (i = 0; i < params.elite; i++) {
+        score_circuit(&e->members[i], e->goals, e->goal_fns, e->goal);
+        e->members[i].fitness = penalized_fitness(&e->members[i]);
+        track_best(e, &e->members[i]);
+      }
+      find_worst(e);
+    }
+    if (e->children % ((long)params.update_interval * params.circuits) == 0) {
+      double best = e->members[0].fitness;
+      for (i = 1; i < params.elite; i++) {
+        if (e->members[i].fitness > best) {
+          best = e->members[i].fitness;
+        }
+      }
+      fprintf(e->log, "%ld: %f %f (effective gates: %d; %s; evaluated: %ld)\n", e->children, best, e->max_fitness, e->max_degree, (e->max_cyclic ? "cyclic" : "acyclic"), e->evaluations);
+    }
+  }
+  pthread_mutex_unlock(&e->lock);
+#if REFERENCE_EVAL
+  free_network(child.network);
+#endif
+  free(child.network);
+  free(child.DNA);
+  free(child.state);
+  return NULL;
+}
+
+/* Seeds the pool with the best elite of params.circuits random circuits and runs
+ * the workers until one of them finds a perfect circuit. Returns the
+ * number of children in generations' worth (params.circuits children), to stay
+ * comparable with the generational loop.
+ */
+int evolve_steady_state(sfmt_t* sfmt, int experiment, const goal_table* goals, void (**goal_fns)(int*, int*), int num_goals, FILE* log) {
+  elite_pool* e = (elite_pool*)malloc(sizeof(elite_pool));
+  pthread_mutex_init(&e->lock, NULL);
+  e->goals = goals;
+  e->goal_fns = goal_fns;
+  e->num_goals = num_goals;
+  e->log = log;
+  e->goal = 0;
+  e->stop = 0;
+  e->members = (circuit*)malloc(sizeof(circuit) * params.elite);
+
+  population* p = make_population(sfmt, 1, experiment, 0);
+  score_population(p, goals, goal_fns, 0);
+  int i;
+  for (i = 0; i < params.elite; i++) {
+    make_circuit(&e->members[i]);
+#if REFERENCE_EVAL
+    create_circuit_network(&e->members[i]);
+#endif
+    copy_circuit(&e->members[i], p->pop[params.circuits - 1 - i]);
+    e->members[i].fitness = p->pop[params.circuits - 1 - i]->fitness;
+  }
+  e->max_fitness = p->max_fitness;
+  e->max_degree = p->max_degree;
+  e->max_cyclic = p->max_cyclic;
+  e->children = params.circuits;
+  e->evaluations = params.circuits;
+  e->stop = e->max_fitness == 1.0;
+  free_population(p);
+  find_worst(e);
+
+  int threads = THREADS > 0 ? THREADS : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+  pthread_t tids[MAX_THREADS];
+  steady_worker workers[MAX_THREADS];
+  for (i = 0; i < threads; i++) {
+    uint32_t key[2] = {sfmt_genrand_uint32(sfmt), (uint32_t)i};
+    sfmt_init_by_array(&workers[i].sfmt, key, 2);
+    workers[i].pool = e;
+    pthread_create(&tids[i], NULL, run_steady_worker, &workers[i]);
+  }
+  for (i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  fprintf(log, "Reached 1.0 after %ld children (%ld evaluated)\n", e->children, e->evaluations);
+  int reached = (int)(e->children / params.circuits);
+
+#if EXPORT_CHAMPION
+  int best = 0;
+  for (i = 1; i < params.elite; i++) {
+    if (e->members[i].fitness > e->members[best].fitness) {
+      best = i;
+    }
+  }
+  export_circuit(CHAMPION_PATH, e->members[best].DNA, "champion");
+#endif
+  for (i = 0; i < params.elite; i++) {
+#if REFERENCE_EVAL
+    free_network(e->members[i].network);
+#endif
+    free(e->members[i].network);
+    free(e->members[i].DNA);
+    free(e->members[i].state);
+  }
+  pthread_mutex_destroy(&e->lock);
+  free(e->members);
+  free(e);
+  return reached;
+}
+
+int time_to_perfect(sfmt_t* sfmt, int experiment, void (**goal_fns)(int*, int*), int num_goals, FILE* log) {
+  fprintf(log, "Running Experiment\n");
+  fprintf(log, "==================\n");
+  fprintf(log, "Iter LocalMax GlobalMax\n");
+
+#if !STEADY_STATE && ISLANDS == 0 && PROCESSES == 0
+  population* p = make_population(sfmt, FARM ? 1 : THREADS, experiment, 0);
+#endif
+
+  goal_table* goals = NULL;
+#if !REFERENCE_EVAL
+  goals = (goal_table*)malloc(sizeof(goal_table) * num_goals);
+  int i;
+  for (i = 0; i < num_goals; i++) {
+    make_goal_table(&goals[i], goal_fns[i]);
+  }
+#endif
+
+  int reached = -1;
+#if STEADY_STATE
+  reached = evolve_steady_state(sfmt, experiment, goals, goal_fns, num_goals, log);
+#elif PROCESSES > 0
+  reached = evolve_processes(sfmt, experiment, goals, goal_fns, num_goals, log);
+#elif ISLANDS > 0
+  reached = evolve_islands(sfmt, experiment, goals, goal_fns, num_goals, log);
+#else
+  int current_goal = 0;
+  int j;
+  for (j = 0; ; j++) {
+    if (j != 0 && j % params.epoch == 0) {
+      current_goal++;
+      current_goal %= num_goals;
+    }
+    score_population(p, goals, goal_fns, current_goal);
+    breed_population(p, sfmt);
+
+    if (reached == -1 && p->max_fitness == 1.0) {
+      reached = j;
+      break;
+    }
+    if ((j + 1) % params.update_interval == 0) {
+      fprintf(log, "%d: %f %f (effective gates: %d; %s; neutral: %.1f%%; distinct: %d)\n", j + 1, p->pop[params.circuits-1]->fitness, p->max_fitness, p->max_degree, (p->max_cyclic ? "cyclic" : "acyclic"), neutral_rate(p), distinct_circuits(p));
+    }
+  }
+
+#if EXPORT_CHAMPION
+  export_circuit(CHAMPION_PATH, p->pop[params.circuits - 1]->DNA, "champion");
+#endif
+#if MEMO
+  fprintf(log, "Fitness memo: %ld lookups, %0.1f%% hits\n", p->memo->lookups, 100.0 * p->memo->hits / p->memo->lookups);
+#endif
+  free_population(p);
+#endif
+  free(goals);
+
+  return reached;
+}
+
+/* Experiment farm: experiments run concurrently, each drawing from its
+ * own SFMT stream seeded with {seed, experiment}, so a result no longer
+ * depends on how much randomness earlier experiments used. Each one logs
+ * into a buffer that is printed in experiment order once it and all
+ * earlier experiments have finished.
+ */
+typedef struct {
+  void (**goal_fns)(int*, int*);
+  int num_goals;
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+  int next;
+  int* reached;
+  char** log;
+  int* done;
+} experiment_farm;
+
+static void* farm_worker(void* arg) {
+  experiment_farm* f = (experiment_farm*)arg;
+  while (1) {
+    pthread_mutex_lock(&f->lock);
+    int e = f->next++;
+    pthread_mutex_unlock(&f->lock);
+    if (e >= params.experiments) {
+      return NULL;
+    }
+
+    sfmt_t sfmt;
+    uint32_t key[2] = {params.seed, (uint32_t)e};
+    sfmt_init_by_array(&sfmt, key, 2);
+    char* log;
+    size_t log_size;
+    FILE* out = open_memstream(&log, &log_size);
+    int reached = time_to_perfect(&sfmt, e, f->goal_fns, f->num_goals, out);
+    fclose(out);
+
+    pthread_mutex_lock(&f->lock);
+    f->reached[e] = reached;
+    f->log[e] = log;
+    f->done[e] = 1;
+    pthread_cond_broadcast(&f->finished);
+    pthread_mutex_unlock(&f->lock);
+  }
+}
+
+void run_farm(void (**goal_fns)(int*, int*), int num_goals) {
+  experiment_farm* f = (experiment_farm*)malloc(sizeof(experiment_farm));
+  f->goal_fns = goal_fns;
+  f->num_goals = num_goals;
+  f->next = 0;
+  f->reached = (int*)malloc(sizeof(int) * params.experiments);
+  f->log = (char**)malloc(sizeof(char*) * params.experiments);
+  f->done = (int*)calloc(params.experiments, sizeof(int));
+  pthread_mutex_init(&f->lock, NULL);
+  pthread_cond_init(&f->finished, NULL);
+
+  int threads = THREADS > 0 ? THREADS : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads > params.experiments) {
+    threads = params.experiments;
+  }
+  if (threads > MAX_THREADS) {
+    threads = MAX_THREADS;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  pthread_t workers[MAX_THREADS];
+  int i;
+  for (i = 0; i < threads; i++) {
+    pthread_create(&workers[i], NULL, farm_worker, f);
+  }
+
+  int total = 0;
+  for (i = 0; i < params.experiments; i++) {
+    pthread_mutex_lock(&f->lock);
+    while (!f->done[i]) {
+      pthread_cond_wait(&f->finished, &f->lock);
+    }
+    pthread_mutex_unlock(&f->lock);
+    fputs(f->log[i], stdout);
+    free(f->log[i]);
+    total += f->reached[i];
+    printf("---------------\nEXPERIMENT #%d: %d iterations (avg: %0.2f)\n\n", i+1, f->reached[i], (double)total / (i+1));
+    fflush(stdout);
+  }
+
+  for (i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  pthread_mutex_destroy(&f->lock);
+  pthread_cond_destroy(&f->finished);
+  free(f->reached);
+  free(f->log);
+  free(f->done);
+  free(f);
+}
+
+/* Runtime options, given as --name=value arguments or as name = value
+ * lines of a file named by --config=path ('#' starts a comment).
+ */
+typedef struct {
+  const char* name;
+  char type;  /* 'i' int, 'u' uint32_t, 'd' double, 'g' goal set name */
+  void* value;
+} option;
+
+static const option options[] = {
+  {"experiments", 'i', &params.experiments},
+  {"seed", 'u', &params.seed},
+  {"mutation", 'd', &params.mutation},
+  {"epoch", 'i', &params.epoch},
+  {"elite", 'i', &params.elite},
+  {"degree", 'i', &params.degree},
+  {"degree_penalty", 'd', &params.degree_penalty},
+  {"update_interval", 'i', &params.update_interval},
+  {"inputs", 'i', &params.inputs},
+  {"gates", 'i', &params.gates},
+  {"outputs", 'i', &params.outputs},
+  {"circuits", 'i', &params.circuits},
+  {"goals", 'g', &params.goals},
+};
+
+int read_config(const char* path);
+
+/* Returns 0 on success, -1 after reporting the problem on stderr. */
+int set_option(const char* name, const char* value) {
+  char* end;
+  int i;
+  if (strcmp(name, "config") == 0) {
+    return read_config(value);
+  }
+  for (i = 0; i < (int)(sizeof(options) / sizeof(options[0])); i++) {
+    if (strcmp(name, options[i].name) != 0) {
+      continue;
+    }
+    if (options[i].type == 'g') {
+      int g;
+      for (g = 0; g < NUM_GOAL_SETS; g++) {
+        if (strcmp(value, goal_sets[g].name) == 0) {
+          *(int*)options[i].value = g;
+          return 0;
+        }
+      }
+    } else if (options[i].type == 'd') {
+      double d = strtod(value, &end);
+      if (*value != '\0' && *end == '\0') {
+        *(double*)options[i].value = d;
+        return 0;
+      }
+    } else {
+      long long l = strtoll(value, &end, 10);
+      if (*value != '\0' && *end == '\0' && options[i].type == 'u' && l >= 0 && l <= UINT32_MAX) {
+        *(uint32_t*)options[i].value = (uint32_t)l;
+        return 0;
+      }
+      if (*value != '\0' && *end == '\0' && options[i].type == 'i' && l >= INT32_MIN && l <= INT32_MAX) {
+        *(int*)options[i].value = (int)l;
+        return 0;
+      }
+    }
+    fprintf(stderr, "%s: bad value '%s'\n", name, value);
+    return -1;
+  }
+  fprintf(stderr, "unknown option '%s'\n", name);
+  return -1;
+}
+
+static char* trim(char* s) {
+  while (*s == ' ' || *s == '\t') {
+    s++;
+  }
+  char* end = s + strlen(s);
+  while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')) {
+    *--end = '\0';
+  }
+  return s;
+}
+
+int read_config(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "cannot read config file '%s'\n", path);
+    return -1;
+  }
+  char line[256];
+  int status = 0;
+  while (status == 0 && fgets(line, sizeof(line), f) != NULL) {
+    char* comment = strchr(line, '#');
+    if (comment != NULL) {
+      *comment = '\0';
+    }
+    char* name = trim(line);
+    if (*name == '\0') {
+      continue;
+    }
+    char* eq = strchr(name, '=');
+    if (eq == NULL) {
+      fprintf(stderr, "%s: expected name = value, got '%s'\n", path, name);
+      status = -1;
+      break;
+    }
+    *eq = '\0';
+    status = set_option(trim(name), trim(eq + 1));
+  }
+  fclose(f);
+  return status;
+}
+
+/* Written so that NaN fails every check. Output genes below the input
+ * count name gates, so there are at least as many gates as inputs.
+ */
+int valid_parameters(const parameters* p) {
+  return p->experiments >= 1 && p->epoch >= 1 && p->update_interval >= 1 &&
+         p->mutation >= 0 && p->mutation <= 1 &&
+         p->inputs >= 1 && p->inputs <= MAX_INPUTS &&
+         p->gates >= p->inputs && p->gates <= MAX_GATES &&
+         p->outputs >= 1 && p->outputs <= MAX_OUTPUTS &&
+         p->circuits <= MAX_CIRCUITS &&
+         p->inputs == goal_sets[p->goals].inputs && p->outputs == goal_sets[p->goals].outputs &&
+         p->elite >= 1 && 2 * p->elite + 1 <= p->circuits &&
+         p->degree >= 0 && p->degree_penalty >= 0 && isfinite(p->degree_penalty);
+}
+
+int parse_arguments(int argc, char** argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    char name[64];
+    const char* eq = strchr(argv[i], '=');
+    if (strncmp(argv[i], "--", 2) != 0 || eq == NULL || eq - argv[i] - 2 >= (int)sizeof(name)) {
+      fprintf(stderr, "usage: %s [--config=path] [--name=value ...]\n", argv[0]);
+      return -1;
+    }
+    memcpy(name, argv[i] + 2, eq - argv[i] - 2);
+    name[eq - argv[i] - 2] = '\0';
+    if (set_option(name, eq + 1) != 0) {
+      return -1;
+    }
+  }
+  if (!valid_parameters(&params)) {
+    fprintf(stderr, "need experiments, epoch, update_interval >= 1, 0 <= mutation <= 1, "
+                    "1 <= inputs <= %d, inputs <= gates <= %d, 1 <= outputs <= %d, "
+                    "circuits <= %d, inputs and outputs matching the goals (%s: %d and %d), "
+                    "1 <= elite <= (circuits - 1) / 2, degree >= 0 and a finite degree_penalty >= 0\n",
+            MAX_INPUTS, MAX_GATES, MAX_OUTPUTS, MAX_CIRCUITS,
+            goal_sets[params.goals].name, goal_sets[params.goals].inputs, goal_sets[params.goals].outputs);
+    return -1;
+  }
+  return 0;
+}
+
+void assertTrue(const char* test, int expr) {
+  if (expr) {
+    printf("%s: PASSED\n", test);
+  } else {
+    printf("%s: FAILED\n", test);
+  }
+}
+
+/* Every invalid value must be rejected, starting from the run's own
+ * parameters, and a goal set is only accepted when its sizes match.
+ */
+void assertParametersChecked(const char* test) {
+  static const char* invalid[][2] = {
+    {"mutation", "nan"}, {"mutation", "-0.1"}, {"mutation", "1.5"},
+    {"degree_penalty", "nan"}, {"degree_penalty", "-1"}, {"degree_penalty", "inf"},
+    {"degree", "-1"}, {"elite", "0"}, {"elite", "1000000"},
+    {"experiments", "0"}, {"epoch", "0"}, {"update_interval", "-5"},
+    {"inputs", "0"}, {"inputs", "9"}, {"gates", "0"}, {"gates", "65"},
+    {"outputs", "0"}, {"outputs", "9"}, {"circuits", "2"}, {"circuits", "2000000"},
+  };
+  parameters saved = params;
+  int i;
+  int passed = valid_parameters(&params);
+  for (i = 0; i < (int)(sizeof(invalid) / sizeof(invalid[0])); i++) {
+    params = saved;
+    passed = passed && set_option(invalid[i][0], invalid[i][1]) == 0 && !valid_parameters(&params);
+  }
+  for (i = 0; i < NUM_GOAL_SETS; i++) {
+    params = saved;
+    int sizes_match = goal_sets[i].inputs == saved.inputs && goal_sets[i].outputs == saved.outputs;
+    passed = passed && set_option("goals", goal_sets[i].name) == 0 && valid_parameters(&params) == sizes_match;
+  }
+  params = saved;
+  assertTrue(test, passed);
+}
+
+void assertListEq(const char* test, int* l1, int* l2, int length) {
+  int i;
+  for (i = 0; i < length; i++) {
+    if (l1[i] != l2[i]) {
+      printf("%s: FAILED\n", test);
+      return;
+    }
+  }
+  printf("%s: PASSED\n", test);
+}
+
+void assertMatrixEq(const char* test, int** l1, int** l2, int length, int sublength) {
+  int i, j;
+  for (i = 0; i < length; i++) {
     for (j = 0; j < sublength; j++) {
       if (l1[i][j] == l2[i][j] && l1[i][j] == INDETERMINATE) {
         break;
       }
-      if (l1[i][j] != l2[i][j]) {
-        printf("%s: FAILED\n", test);
-        return;
+      if (l1[i][j] != l2[i][j]) {
+        printf("%s: FAILED\n", test);
+        return;
+      }
+    }
+  }
+  printf("%s: PASSED\n", test);
+}
+
+void assertBitslicedEq(const char* test, network* n) {
+  int max_val = 1 << n->num_inputs;
+  int bin_input[MAX_INPUTS];
+  int output[MAX_GATES];
+  dual_rail sliced[MAX_GATES];
+  int i, j;
+
+  for (i = 0; i < max_val; i++) {
+    int k = i % PATTERN_BITS;
+    pattern_word settled = eval_network_bitsliced(sliced, n, i / PATTERN_BITS);
+    for (j = 0; j < n->num_inputs; j++) {
+      bin_input[n->num_inputs - j - 1] = (i >> j) & 1;
+    }
+    int ok = eval_network(output, n, bin_input);
+    if (ok != (int)((settled >> k) & 1)) {
+      printf("%s: FAILED\n", test);
+      return;
+    }
+    for (j = 0; ok && j < n->num_outputs; j++) {
+      if (output[j] != (int)((sliced[j].one >> k) & 1)) {
+        printf("%s: FAILED\n", test);
+        return;
+      }
+    }
+  }
+  printf("%s: PASSED\n", test);
+}
+
+/* The random-circuit tests start from an SFMT seeded with SEED, the
+ * table of TEST_GOAL (the first goal of the run's set, so that they hold
+ * at any size) and a circuit with its gate graph.
+ */
+#define TEST_GOAL (goal_sets[params.goals].fns[0])
+
+void make_test_fixture(sfmt_t* sfmt, goal_table* goal, circuit* c) {
+  sfmt_init_gen_rand(sfmt, SEED);
+  make_goal_table(goal, TEST_GOAL);
+  make_circuit(c);
+  create_circuit_network(c);
+}
+
+void free_test_circuit(circuit* c) {
+  free_network(c->network);
+  free(c->network);
+  free(c->DNA);
+  free(c->state);
+}
+
+/* Cross-checks a fast fitness function against eval_network_fitness_vector
+ * on random circuits.
+ */
+void assertFitnessMatches(const char* test, double (*fitness)(network*, void (*)(int*, int*)), int trials) {
+  sfmt_t sfmt;
+  goal_table goal;
+  circuit c;
+  make_test_fixture(&sfmt, &goal, &c);
+  int i;
+  int passed = 1;
+  for (i = 0; i < trials; i++) {
+    random_dna(&sfmt, &c);
+    circuitize(&c);
+    if (fitness(c.network, TEST_GOAL) != eval_network_fitness_vector(c.network, TEST_GOAL)) {
+      passed = 0;
+      break;
+    }
+  }
+  free_test_circuit(&c);
+  assertTrue(test, passed);
+}
+
+void assertEvalMatches(const char* test, int (*eval)(int*, network*, int*), int trials) {
+  sfmt_t sfmt;
+  goal_table goal;
+  circuit c;
+  make_test_fixture(&sfmt, &goal, &c);
+  int bin_input[MAX_INPUTS];
+  int output_1[MAX_OUTPUTS], output_2[MAX_OUTPUTS];
+  int i, j, k;
+  int passed = 1;
+  for (i = 0; i < trials && passed; i++) {
+    random_dna(&sfmt, &c);
+    circuitize(&c);
+    for (j = 0; j < (1 << params.inputs) && passed; j++) {
+      for (k = 0; k < params.inputs; k++) {
+        bin_input[params.inputs - k - 1] = (j >> k) & 1;
+      }
+      int ok = eval(output_1, c.network, bin_input);
+      passed = ok == eval_network_sweep(output_2, c.network, bin_input);
+      for (k = 0; ok && passed && k < params.outputs; k++) {
+        passed = output_1[k] == output_2[k];
+      }
+    }
+  }
+  free_test_circuit(&c);
+  assertTrue(test, passed);
+}
+
+void assertDnaMatches(const char* test, int trials) {
+  sfmt_t sfmt;
+  goal_table goal;
+  circuit c;
+  make_test_fixture(&sfmt, &goal, &c);
+  condensation cond;
+  int i, g;
+  int passed = 1;
+  for (i = 0; i < trials && passed; i++) {
+    random_dna(&sfmt, &c);
+    circuitize(&c);
+    uint64_t cone = output_cone(c.DNA);
+    for (g = 0; g < params.gates; g++) {
+      int reaches = (fanout_cone(c.DNA, (uint64_t)1 << g) & dna_outputs(c.DNA)) != 0;
+      passed &= reaches == (int)((cone >> g) & 1);
+    }
+    passed = passed && eval_dna_fitness(c.DNA, &goal) == eval_network_fitness_vector(c.network, TEST_GOAL) &&
+             dna_degree(c.DNA) == degree(c.network, 0) &&
+             dna_has_cycle(c.DNA) == has_cycle(c.network) &&
+             (condense_dna(c.DNA, &cond), cond.acyclic == !has_cycle(c.network)) &&
+             (cond.live & cone) == cone && (!cond.acyclic || cond.live == cone) && dna_live(c.DNA) == cond.live &&
+             levelize(c.network) == !has_cycle(c.network);
+  }
+  free_test_circuit(&c);
+  assertTrue(test, passed);
+}
+
+void assertIncrementalMatches(const char* test, int trials) {
+  sfmt_t sfmt;
+  goal_table goal;
+  circuit c;
+  make_test_fixture(&sfmt, &goal, &c);
+  circuit_state* state = (circuit_state*)malloc(STATE_BYTES);
+  circuit_state* full = (circuit_state*)malloc(STATE_BYTES);
+  uint64_t m;
+  int i, b;
+  int passed = 1;
+  for (i = 0; i < trials && passed; i++) {
+    if (i % 50 == 0) {
+      random_dna(&sfmt, &c);
+      eval_dna_state(state, c.DNA);
+    } else {
+      int locus = rand_range(&sfmt, 0, DNA_LENGTH);
+      c.DNA[locus] = rand_range(&sfmt, 0, params.gates + params.inputs);
+      uint64_t rewired = 0;
+      if (locus < params.gates * INPUTS_PER_GATE) {
+        rewired = (uint64_t)1 << (locus / INPUTS_PER_GATE);
+      }
+      update_dna_state(state, c.DNA, rewired);
+    }
+    eval_dna_state(full, c.DNA);
+    circuitize(&c);
+    double f = (double)score_dna_state(state, c.DNA, &goal) / (PATTERNS * params.outputs);
+    passed = full->live == state->live && f == eval_network_fitness_vector(c.network, TEST_GOAL);
+    for (b = 0; b < PATTERN_WORDS && passed; b++) {
+      passed = memcmp(full->signal + b * SLOTS, state->signal + b * SLOTS, params.inputs * sizeof(dual_rail)) == 0;
+      for (m = full->live; m && passed; m &= m - 1) {
+        int slot = params.inputs + __builtin_ctzll(m);
+        passed = memcmp(&full->signal[b * SLOTS + slot], &state->signal[b * SLOTS + slot], sizeof(dual_rail)) == 0;
+      }
+    }
+  }
+  free(state);
+  free(full);
+  free_test_circuit(&c);
+  assertTrue(test, passed);
+}
+
+void assertNeutralMatches(const char* test, int trials) {
+  sfmt_t sfmt;
+  goal_table goal;
+  circuit c;
+  make_test_fixture(&sfmt, &goal, &c);
+  free(c.state);
+  c.state = NULL;
+  int neutral = 0;
+  int i;
+  int passed = 1;
+  for (i = 0; i < trials && passed; i++) {
+    if (i % 50 == 0) {
+      random_dna(&sfmt, &c);
+    }
+    c.score = eval_dna_fitness(c.DNA, &goal);
+    c.cone = output_cone(c.DNA);
+    c.degree = dna_degree(c.DNA);
+    c.cyclic = -1;
+    c.goal = 0;
+    gene value;
+    int locus = draw_mutation(&sfmt, &value);
+    if (locus < 0) {
+      continue;
+    }
+    int marked = mark_mutated(&c, locus, value);
+    c.DNA[locus] = value;
+    if (marked) {
+      neutral++;
+      passed = c.goal == 0 && eval_dna_fitness(c.DNA, &goal) == c.score &&
+               output_cone(c.DNA) == c.cone && dna_degree(c.DNA) == c.degree &&
+               (c.cyclic == -1 || dna_has_cycle(c.DNA) == c.cyclic);
+    }
+  }
+  free_test_circuit(&c);
+  assertTrue(test, passed && neutral > 0);
+}
+
+/* Renumbers the gates of random circuits and swaps operands. The
+ * canonical form must score like the original, and must not change for
+ * acyclic circuits (symmetric cycles may be numbered either way).
+ */
+void assertCanonicalMatches(const char* test, int trials) {
+  sfmt_t sfmt;
+  goal_table goal;
+  circuit c;
+  make_test_fixture(&sfmt, &goal, &c);
+  gene shuffled[MAX_DNA_LENGTH];
+  gene canon[MAX_DNA_LENGTH];
+  gene shuffled_canon[MAX_DNA_LENGTH];
+  int perm[MAX_GATES];
+  int i, j;
+  int passed = 1;
+  for (i = 0; i < trials && passed; i++) {
+    random_dna(&sfmt, &c);
+    for (j = 0; j < params.gates; j++) {
+      perm[j] = j;
+    }
+    for (j = params.gates - 1; j > 0; j--) {
+      int k = rand_range(&sfmt, 0, j + 1);
+      int t = perm[j];
+      perm[j] = perm[k];
+      perm[k] = t;
+    }
+    for (j = 0; j < params.gates * INPUTS_PER_GATE; j++) {
+      int address = c.DNA[j];
+      int swap = perm[j / INPUTS_PER_GATE] * INPUTS_PER_GATE + (j % INPUTS_PER_GATE);
+      shuffled[swap] = address < params.inputs ? address : params.inputs + perm[address - params.inputs];
+    }
+    for (j = 0; j < params.gates; j++) {
+      if (rand_range(&sfmt, 0, 2)) {
+        gene t = shuffled[j * INPUTS_PER_GATE];
+        shuffled[j * INPUTS_PER_GATE] = shuffled[j * INPUTS_PER_GATE + 1];
+        shuffled[j * INPUTS_PER_GATE + 1] = t;
+      }
+    }
+    for (j = 0; j < params.outputs; j++) {
+      int g = dna_output_slot(c.DNA[params.gates * INPUTS_PER_GATE + j]) - params.inputs;
+      shuffled[params.gates * INPUTS_PER_GATE + j] = params.inputs + perm[g];
+    }
+    canonical_dna(c.DNA, canon);
+    canonical_dna(shuffled, shuffled_canon);
+    passed = (memcmp(canon, shuffled_canon, DNA_LENGTH * sizeof(gene)) == 0 || dna_has_cycle(c.DNA)) &&
+             eval_dna_fitness(canon, &goal) == eval_dna_fitness(c.DNA, &goal) &&
+             dna_degree(canon) == dna_degree(c.DNA) &&
+             dna_has_cycle(canon) == dna_has_cycle(c.DNA);
+  }
+  free_test_circuit(&c);
+  assertTrue(test, passed);
+}
+
+void assertMemoMatches(const char* test, int trials) {
+  sfmt_t sfmt;
+  goal_table goal;
+  circuit c, d;
+  make_test_fixture(&sfmt, &goal, &c);
+  make_circuit(&d);
+  create_circuit_network(&d);
+  memo_table* memo = make_memo_table();
+  int i;
+  int passed = 1;
+  for (i = 0; i < trials && passed; i++) {
+    random_dna(&sfmt, &c);
+    circuitize(&c);
+    c.score = eval_network_fitness_vector(c.network, TEST_GOAL);
+    c.cone = output_cone(c.DNA);
+    c.degree = degree(c.network, 0);
+    c.cyclic = has_cycle(c.network);
+    c.goal = 0;
+    memo_insert(memo, &c);
+    memcpy(d.DNA, c.DNA, sizeof(gene) * DNA_LENGTH);
+    passed = memo_lookup(memo, &d, 0) && !memo_lookup(memo, &d, 1) &&
+             d.score == c.score && d.cone == c.cone && d.degree == c.degree && d.cyclic == c.cyclic;
+  }
+  passed = passed && memo->hits == trials;
+  free_memo_table(memo);
+  free_test_circuit(&c);
+  free_test_circuit(&d);
+  assertTrue(test, passed);
+}
+
+void assertCompiledMatches(const char* test, int trials) {
+  sfmt_t sfmt;
+  sfmt_init_gen_rand(&sfmt, SEED);
+  goal_table goal;
+  make_goal_table(&goal, TEST_GOAL);
+  circuit* c = (circuit*)malloc(sizeof(circuit) * trials);
+  gene** dna = (gene**)malloc(sizeof(gene*) * trials);
+  int i;
+  for (i = 0; i < trials; i++) {
+    make_circuit(&c[i]);
+    create_circuit_network(&c[i]);
+    random_dna(&sfmt, &c[i]);
+    dna[i] = c[i].DNA;
+  }
+  kernel_library* k = compile_circuits(dna, trials);
+  if (k == NULL) {
+    printf("%s: SKIPPED\n", test);
+  } else {
+    int passed = 1;
+    for (i = 0; i < trials && passed; i++) {
+      passed = eval_kernel_fitness(k->kernels[i], &goal) == eval_dna_fitness(c[i].DNA, &goal);
+    }
+    free_kernel_library(k);
+    assertTrue(test, passed);
+  }
+  for (i = 0; i < trials; i++) {
+    free_test_circuit(&c[i]);
+  }
+  free(dna);
+  free(c);
+}
+
+void assertPoolMatches(const char* test, int threads, int trials) {
+  sfmt_t sfmt;
+  sfmt_init_gen_rand(&sfmt, SEED);
+  goal_table goal;
+  make_goal_table(&goal, TEST_GOAL);
+  void (*goal_fns[1])(int*, int*) = {TEST_GOAL};
+  eval_pool* pool = make_eval_pool(threads);
+  circuit* c = (circuit*)malloc(params.circuits * sizeof(circuit));
+  circuit** pending = (circuit**)malloc(params.circuits * sizeof(circuit*));
+  int i, t;
+  int passed = 1;
+  for (i = 0; i < params.circuits; i++) {
+    make_circuit(&c[i]);
+    create_circuit_network(&c[i]);
+    pending[i] = &c[i];
+  }
+  for (t = 0; t < trials && passed; t += params.circuits) {
+    for (i = 0; i < params.circuits; i++) {
+      random_dna(&sfmt, &c[i]);
+      c[i].goal = -1;
+#if INCREMENTAL
+      c[i].state->valid = 0;
+#endif
+    }
+    score_circuits(pool, pending, params.circuits, &goal, goal_fns, 0);
+    for (i = 0; i < params.circuits && passed; i++) {
+      circuitize(&c[i]);
+      passed = c[i].score == eval_network_fitness_vector(c[i].network, TEST_GOAL) &&
+               c[i].degree == degree(c[i].network, 0);
+    }
+  }
+  free_eval_pool(pool);
+  for (i = 0; i < params.circuits; i++) {
+    free_test_circuit(&c[i]);
+  }
+  free(c);
+  free(pending);
+  assertTrue(test, passed);
+}
+
+void assertSelectionMatches(const char* test, int trials) {
+  sfmt_t sfmt;
+  sfmt_init_gen_rand(&sfmt, SEED);
+  int* rank = make_fitness_ranks();
+  circuit* c = (circuit*)malloc(params.circuits * sizeof(circuit));
+  circuit** pop = (circuit**)malloc(params.circuits * sizeof(circuit*));
+  circuit** expected = (circuit**)malloc(params.circuits * sizeof(circuit*));
+  int i, j, t;
+  int passed = 1;
+  for (t = 0; t < trials && passed; t += params.circuits) {
+    for (i = 0; i < params.circuits; i++) {
+      c[i].score = (double)rand_range(&sfmt, 0, PATTERNS * params.outputs + 1) / (PATTERNS * params.outputs);
+      c[i].degree = rand_range(&sfmt, 0, params.gates + 1);
+      c[i].fitness = c[i].score;
+      if (c[i].degree > params.degree) {
+        c[i].fitness -= params.degree_penalty * (c[i].degree - params.degree);
+      }
+      pop[i] = &c[i];
+      /* stable insertion sort as the reference */
+      for (j = i; j > 0 && expected[j - 1]->fitness > c[i].fitness; j--) {
+        expected[j] = expected[j - 1];
+      }
+      expected[j] = &c[i];
+    }
+    sort_population(pop, rank);
+    passed = memcmp(pop, expected, params.circuits * sizeof(circuit*)) == 0;
+  }
+  free(rank);
+  free(c);
+  free(pop);
+  free(expected);
+  assertTrue(test, passed);
+}
+
+void assertRingFifo(const char* test) {
+  migration_ring* r = (migration_ring*)malloc(sizeof(migration_ring));
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  gene dna[MAX_DNA_LENGTH];
+  int i, round;
+  int passed = 1;
+  for (round = 0; round < 3; round++) {
+    for (i = 0; i < MIGRATION_SLOTS; i++) {
+      memset(dna, i, sizeof(dna));
+      passed &= ring_push(r, dna);
+    }
+    passed &= !ring_push(r, dna);
+    for (i = 0; i < MIGRATION_SLOTS; i++) {
+      passed &= ring_pop(r, dna) && dna[0] == i && dna[DNA_LENGTH - 1] == i;
+    }
+    passed &= !ring_pop(r, dna);
+  }
+  free(r);
+  assertTrue(test, passed);
+}
+
+/* Migrants must arrive intact and score as they did on their own island,
+ * and the arena must still hold one reference per circuit.
+ */
+void assertMigration(const char* test) {
+  sfmt_t sfmt;
+  sfmt_init_gen_rand(&sfmt, SEED);
+  goal_table goal;
+  make_goal_table(&goal, TEST_GOAL);
+  void (*goal_fns[1])(int*, int*) = {TEST_GOAL};
+  population* from = make_population(&sfmt, 1, 0, 0);
+  population* to = make_population(&sfmt, 1, 0, 1);
+  migration_ring* r = (migration_ring*)malloc(sizeof(migration_ring));
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  gene migrant[MAX_DNA_LENGTH];
+  int arrived = 0;
+  int refs = 0;
+  int i, k;
+  score_population(from, &goal, goal_fns, 0);
+  score_population(to, &goal, goal_fns, 0);
+  for (i = 0; i < MIGRANTS; i++) {
+    ring_push(r, from->pop[params.circuits - 1 - i]->DNA);
+  }
+  breed_population(to, &sfmt);
+  while (ring_pop(r, migrant)) {
+    replace_genome(to, to->pop[params.elite + arrived++], migrant);
+  }
+  score_population(to, &goal, goal_fns, 0);
+  int passed = arrived == MIGRANTS;
+  for (i = 0; i < MIGRANTS; i++) {
+    const circuit* m = from->pop[params.circuits - 1 - i];
+    int found = 0;
+    for (k = 0; k < params.circuits; k++) {
+      found |= memcmp(to->pop[k]->DNA, m->DNA, DNA_LENGTH * sizeof(gene)) == 0 && to->pop[k]->score == m->score;
+    }
+    passed &= found;
+  }
+  for (k = 0; k < params.circuits; k++) {
+    refs += to->arena.refs[k];
+  }
+  passed &= refs == params.circuits;
+  free(r);
+  free_population(from);
+  free_population(to);
+  assertTrue(test, passed);
+}
+
+void assertBulkUniform(const char* test, int trials) {
+  sfmt_t sfmt;
+  sfmt_init_gen_rand(&sfmt, SEED);
+  rng_buffer* r = (rng_buffer*)aligned_alloc(16, (sizeof(rng_buffer) + 15) / 16 * 16);
+  init_rng_buffer(r, &sfmt);
+  int count[MAX_DNA_LENGTH] = {0};
+  int mutated = 0;
+  int i;
+  int passed = 1;
+  for (i = 0; i < trials * DNA_LENGTH; i++) {
+    uint32_t v = bulk_range(r, DNA_LENGTH, LOCUS_REJECT);
+    passed &= v < (uint32_t)DNA_LENGTH;
+    count[v < (uint32_t)DNA_LENGTH ? v : 0]++;
+    mutated += next_word(r) < MUTATION_THRESHOLD;
+  }
+  for (i = 0; i < DNA_LENGTH; i++) {
+    passed &= count[i] > trials * 9 / 10 && count[i] < trials * 11 / 10;
+  }
+  passed &= mutated > params.mutation * trials * DNA_LENGTH * 0.98 && mutated < params.mutation * trials * DNA_LENGTH * 1.02;
+  free_rng_buffer(r);
+  free(r);
+  assertTrue(test, passed);
+}
+
+#if RNG == RNG_PHILOX
+/* Populations draw from (seed, experiment) alone, whatever the SFMT
+ * stream they are handed.
+ */
+void assertPhiloxStreams(const char* test) {
+  sfmt_t a, b;
+  sfmt_init_gen_rand(&a, SEED);
+  sfmt_init_gen_rand(&b, SEED + 1);
+  population* p = make_population(&a, 1, 3, 0);
+  population* q = make_population(&b, 1, 3, 0);
+  population* r = make_population(&a, 1, 4, 0);
+  int i;
+  int same = 1;
+  int other = 1;
+  for (i = 0; i < params.circuits; i++) {
+    same &= memcmp(p->circuits[i].DNA, q->circuits[i].DNA, DNA_LENGTH * sizeof(gene)) == 0;
+    other &= memcmp(p->circuits[i].DNA, r->circuits[i].DNA, DNA_LENGTH * sizeof(gene)) == 0;
+  }
+  free_population(p);
+  free_population(q);
+  free_population(r);
+  assertTrue(test, same && !other);
+}
+#endif
+
+void assertPhiloxKnownAnswers(const char* test) {
+  uint32_t zero_counter[4] = {0, 0, 0, 0};
+  uint32_t zero_key[2] = {0, 0};
+  uint32_t ones_counter[4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+  uint32_t ones_key[2] = {0xffffffff, 0xffffffff};
+  uint32_t pi_counter[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+  uint32_t pi_key[2] = {0xa4093822, 0x299f31d0};
+  uint32_t out[4];
+  int passed = 1;
+  philox4x32(zero_counter, zero_key, out);
+  passed &= out[0] == 0x6627e8d5 && out[1] == 0xe169c58d && out[2] == 0xbc57ac4c && out[3] == 0x9b00dbd8;
+  philox4x32(ones_counter, ones_key, out);
+  passed &= out[0] == 0x408f276d && out[1] == 0x41c83b0e && out[2] == 0xa20bc7c6 && out[3] == 0x6d5451fd;
+  philox4x32(pi_counter, pi_key, out);
+  passed &= out[0] == 0xd16cfe09 && out[1] == 0x94fdcceb && out[2] == 0x5001e420 && out[3] == 0x24126ea1;
+  assertTrue(test, passed);
+}
+
+void assertSimdMatches(const simd_engine* e, int trials) {
+  char test[64];
+  sprintf(test, "SIMD %s", e->name);
+  if (!simd_supported(e)) {
+    printf("%s: SKIPPED\n", test);
+    return;
+  }
+
+  sfmt_t sfmt;
+  sfmt_init_gen_rand(&sfmt, SEED);
+  goal_table goal;
+  make_goal_table(&goal, TEST_GOAL);
+  circuit* c = (circuit*)malloc(params.circuits * sizeof(circuit));
+  gene** dna = (gene**)malloc(params.circuits * sizeof(gene*));
+  double* fitness = (double*)malloc(params.circuits * sizeof(double));
+  int i, t;
+  int passed = 1;
+  for (i = 0; i < params.circuits; i++) {
+    make_circuit(&c[i]);
+    create_circuit_network(&c[i]);
+    dna[i] = c[i].DNA;
+  }
+  for (t = 0; t < trials && passed; t += params.circuits) {
+    for (i = 0; i < params.circuits; i++) {
+      random_dna(&sfmt, &c[i]);
+    }
+    /* an odd count exercises the partially filled last batch */
+    eval_population_simd(e, fitness, dna, params.circuits - 1, &goal, (t / params.circuits) % 2);
+    for (i = 0; i < params.circuits - 1; i++) {
+      circuitize(&c[i]);
+      if (fitness[i] != eval_network_fitness_vector(c[i].network, TEST_GOAL)) {
+        passed = 0;
+        break;
+      }
+    }
+  }
+  for (i = 0; i < params.circuits; i++) {
+    free_test_circuit(&c[i]);
+  }
+  free(c);
+  free(dna);
+  free(fitness);
+  assertTrue(test, passed);
+}
+
+static uint64_t random_word(sfmt_t* sfmt) {
+  uint64_t high = sfmt_genrand_uint32(sfmt);
+  return high << 32 | sfmt_genrand_uint32(sfmt);
+}
+
+/* Every sized instance must agree with the generic kernels at its sizes,
+ * on random DNA and a random goal table: the incremental state after a
+ * mutation, the fixpoints of every engine, and the mutation draws.
+ */
+void assertSizedMatches(const char* test, int trials) {
+  parameters saved = params;
+  const sized_kernels* chosen = sized;
+  sfmt_t sfmt;
+  sfmt_init_gen_rand(&sfmt, SEED);
+  int passed = 1;
+  int k, t, i, b;
+  for (k = 0; k < NUM_SIZED_KERNELS && passed; k++) {
+    const sized_kernels* s = &sized_kernel_table[k];
+    const sized_kernels* g = &generic_kernels;
+    params.inputs = s->inputs;
+    params.gates = s->gates;
+    params.outputs = s->outputs;
+    goal_table goal;
+    memset(&goal, 0, sizeof(goal_table));
+    for (i = 0; i < params.outputs; i++) {
+      for (b = 0; b < PATTERN_WORDS; b++) {
+        goal.expected[i][b] = random_word(&sfmt) & block_mask(params.inputs);
+      }
+    }
+    circuit_state* state = (circuit_state*)malloc(STATE_BYTES);
+    circuit_state* full = (circuit_state*)malloc(STATE_BYTES);
+    gene dna[MAX_DNA_LENGTH];
+    gene* batch = dna;
+    for (t = 0; t < trials && passed; t++) {
+      for (i = 0; i < DNA_LENGTH; i++) {
+        dna[i] = rand_range(&sfmt, 0, SLOTS);
+      }
+      uint64_t gates = random_word(&sfmt) & (((uint64_t)1 << params.gates) - 1);
+      passed = s->output_cone(dna) == g->output_cone(dna) && s->has_cycle(dna) == g->has_cycle(dna) &&
+               s->live(dna) == g->live(dna) && s->fanout_cone(dna, gates) == g->fanout_cone(dna, gates);
+      s->eval_state(state, dna);
+      g->eval_state(full, dna);
+      passed = passed && s->score_state(state, dna, &goal) == g->score_state(full, dna, &goal);
+      int locus = rand_range(&sfmt, 0, params.gates * INPUTS_PER_GATE);
+      dna[locus] = rand_range(&sfmt, 0, SLOTS);
+      s->update_state(state, dna, (uint64_t)1 << (locus / INPUTS_PER_GATE));
+      g->eval_state(full, dna);
+      passed = passed && state->live == full->live &&
+               s->score_state(state, dna, &goal) == g->score_state(full, dna, &goal);
+      for (i = 0; i < NUM_SIMD_ENGINES && passed; i++) {
+        if (simd_supported(&simd_engines[i])) {
+          double fs, fg;
+          sized = s;
+          eval_population_simd(&simd_engines[i], &fs, &batch, 1, &goal, t % 2);
+          sized = g;
+          eval_population_simd(&simd_engines[i], &fg, &batch, 1, &goal, t % 2);
+          passed = fs == fg;
+        }
       }
+      sfmt_t sfmt_s = sfmt, sfmt_g = sfmt;
+      gene value_s = 0, value_g = 0;
+      passed = passed && s->draw_mutation(&sfmt_s, &value_s) == g->draw_mutation(&sfmt_g, &value_g) &&
+               value_s == value_g;
+      uint32_t key[2] = {sfmt_genrand_uint32(&sfmt), (uint32_t)t};
+      passed = passed && s->draw_mutation_philox(key, 0, t, &value_s) == g->draw_mutation_philox(key, 0, t, &value_g) &&
+               value_s == value_g;
     }
+    free(state);
+    free(full);
   }
-  printf("%s: PASSED\n", test);
+  params = saved;
+  sized = chosen;
+  assertTrue(test, passed);
+}
+
+/* Frees a network that RunTests built on the stack: its gates, inputs
+ * and condensation, but not the arrays holding them.
+ */
+void free_test_network(network* n) {
+  int i;
+  for (i = 0; i < n->num_gates; i++) {
+    free_gate(n->gates[i]);
+    free(n->gates[i]);
+  }
+  for (i = 0; i < n->num_inputs; i++) {
+    free_gate(n->inputs[i]);
+    free(n->inputs[i]);
+  }
+  free(n->condensed);
 }
 
 void RunTests() {
   printf("Running Tests\n");
   printf("=============\n");
+  assertParametersChecked("Parameters");
+
   int test1_1[4] = {INDETERMINATE, 1, INDETERMINATE, 0};
   int test1_2[4] = {1,1,1,0};
   assertTrue("Subset 1", subset_v(test1_1, test1_2, 4));
@@ -793,6 +5200,18 @@ void RunTests() {
 
   int i;
 
+  gate shared;
+  int (*shared_fns[4])(int*) = {and_g, or_g, xor_g, nand_g};
+  int shared_ok = 1;
+  for (i = 0; i < 4 * 9; i++) {
+    int vals[2] = {i / 3 % 3 - 1, i % 3 - 1};
+    make_gate(&shared, shared_fns[i / 9], 2);
+    shared_ok &= eval_gate_inp(&shared, vals) == ternary_ext(shared_fns[i / 9], 2, vals);
+    free(shared.inputs);
+    free(shared.outputs);
+  }
+  assertTrue("Shared tables", shared_ok);
+
   gate* n1[1];
   n1[0] = (gate*)malloc(sizeof(gate));
   make_gate(n1[0], and_g, 2);
@@ -801,9 +5220,9 @@ void RunTests() {
   n_i1[1] = (gate*)malloc(sizeof(gate));
   make_gate(n_i1[0], input_g, 1);
   make_gate(n_i1[1], input_g, 1);
-  connect(n_i1[0], n1[0]);
-  connect(n_i1[1], n1[0]);
-  network n_1 = {n1, 1, n_i1, 2, n1, 1};
+  connect_gates(n_i1[0], n1[0]);
+  connect_gates(n_i1[1], n1[0]);
+  network n_1 = {n1, 1, n_i1, 2, n1, 1, NULL};
   int* output_1[4];
   int* t1[4];
   int t_1_1[1] = {0},
@@ -816,11 +5235,10 @@ void RunTests() {
   t1[3] = t_1_4;
   eval_network_all(output_1, &n_1);
   assertMatrixEq("Network 1", output_1, t1, 4, 1);
+  assertBitslicedEq("Bitsliced 1", &n_1);
   int cyclic = has_cycle(&n_1);
   assert(!cyclic);
-  free(n1[0]);
-  free(n_i1[0]);
-  free(n_i1[1]);
+  free_test_network(&n_1);
   for (i = 0; i < 4; i++) {
     free(output_1[i]);
   }
@@ -835,13 +5253,13 @@ void RunTests() {
   n_i2[1] = (gate*)malloc(sizeof(gate));
   make_gate(n_i2[0], input_g, 1);
   make_gate(n_i2[1], input_g, 1);
-  connect(n_i2[0], n2[0]);
-  connect(n_i2[1], n2[1]);
-  connect(n2[0], n2[1]);
-  connect(n2[1], n2[0]);
+  connect_gates(n_i2[0], n2[0]);
+  connect_gates(n_i2[1], n2[1]);
+  connect_gates(n2[0], n2[1]);
+  connect_gates(n2[1], n2[0]);
   gate* o2[1];
   o2[0] = n2[1];
-  network n_2 = {n2, 2, n_i2, 2, o2, 1};
+  network n_2 = {n2, 2, n_i2, 2, o2, 1, NULL};
   int* output_2[4];
   int* t2[4];
   int t_2_1[1] = {0},
@@ -854,12 +5272,10 @@ void RunTests() {
   t2[3] = t_2_4;
   eval_network_all(output_2, &n_2);
   assertMatrixEq("Network 2", output_2, t2, 4, 1);
+  assertBitslicedEq("Bitsliced 2", &n_2);
   cyclic = has_cycle(&n_2);
   assert(cyclic);
-  free(n2[0]);
-  free(n2[1]);
-  free(n_i2[0]);
-  free(n_i2[1]);
+  free_test_network(&n_2);
   for (i = 0; i < 4; i++) {
     free(output_2[i]);
   }
@@ -884,19 +5300,19 @@ void RunTests() {
   make_gate(n_i3[0], input_g, 1);
   make_gate(n_i3[1], input_g, 1);
   make_gate(n_i3[2], input_g, 1);
-  connect(n_i3[0], n3[0]);
-  connect(n_i3[0], n3[3]);
-  connect(n_i3[1], n3[1]);
-  connect(n_i3[1], n3[4]);
-  connect(n_i3[2], n3[2]);
-  connect(n_i3[2], n3[5]);
-  connect(n3[0], n3[1]);
-  connect(n3[1], n3[2]);
-  connect(n3[2], n3[3]);
-  connect(n3[3], n3[4]);
-  connect(n3[4], n3[5]);
-  connect(n3[5], n3[0]);
-  network n_3 = {n3, 6, n_i3, 3, n3, 6};
+  connect_gates(n_i3[0], n3[0]);
+  connect_gates(n_i3[0], n3[3]);
+  connect_gates(n_i3[1], n3[1]);
+  connect_gates(n_i3[1], n3[4]);
+  connect_gates(n_i3[2], n3[2]);
+  connect_gates(n_i3[2], n3[5]);
+  connect_gates(n3[0], n3[1]);
+  connect_gates(n3[1], n3[2]);
+  connect_gates(n3[2], n3[3]);
+  connect_gates(n3[3], n3[4]);
+  connect_gates(n3[4], n3[5]);
+  connect_gates(n3[5], n3[0]);
+  network n_3 = {n3, 6, n_i3, 3, n3, 6, NULL};
   int* output_3[8];
   int* t3[8];
   int t_3_1[6] = {0, 0, 0, 0, 0, 0},
@@ -917,14 +5333,10 @@ void RunTests() {
   t3[7] = t_3_8;
   eval_network_all(output_3, &n_3);
   assertMatrixEq("Network 3", output_3, t3, 8, 6);
+  assertBitslicedEq("Bitsliced 3", &n_3);
   cyclic = has_cycle(&n_3);
   assert(cyclic);
-  for (i = 0; i < 6; i++) {
-    free(n3[i]);
-  }
-  for (i = 0; i < 3; i++) {
-    free(n_i3[i]);
-  }
+  free_test_network(&n_3);
   for (i = 0; i < 8; i++) {
     free(output_3[i]);
   }
@@ -939,277 +5351,95 @@ void RunTests() {
     n_i_4[i] = (gate*)malloc(sizeof(gate));
     make_gate(n_i_4[i], input_g, 1);
   }
-  connect(n_i_4[0], n_4[0]);
-  connect(n_i_4[0], n_4[3]);
-  connect(n_i_4[1], n_4[0]);
-  connect(n_i_4[1], n_4[4]);
-  connect(n_i_4[2], n_4[2]);
-  connect(n_i_4[2], n_4[1]);
-  connect(n_i_4[3], n_4[1]);
-  connect(n_i_4[3], n_4[5]);
-  connect(n_4[0], n_4[2]);
-  connect(n_4[0], n_4[5]);
-  connect(n_4[1], n_4[3]);
-  connect(n_4[1], n_4[4]);
-  connect(n_4[2], n_4[6]);
-  connect(n_4[3], n_4[7]);
-  connect(n_4[4], n_4[7]);
-  connect(n_4[5], n_4[6]);
-  connect(n_4[6], n_4[8]);
-  connect(n_4[7], n_4[8]);
-  connect(n_4[8], n_4[9]);
-  connect(n_4[8], n_4[9]);
+  connect_gates(n_i_4[0], n_4[0]);
+  connect_gates(n_i_4[0], n_4[3]);
+  connect_gates(n_i_4[1], n_4[0]);
+  connect_gates(n_i_4[1], n_4[4]);
+  connect_gates(n_i_4[2], n_4[2]);
+  connect_gates(n_i_4[2], n_4[1]);
+  connect_gates(n_i_4[3], n_4[1]);
+  connect_gates(n_i_4[3], n_4[5]);
+  connect_gates(n_4[0], n_4[2]);
+  connect_gates(n_4[0], n_4[5]);
+  connect_gates(n_4[1], n_4[3]);
+  connect_gates(n_4[1], n_4[4]);
+  connect_gates(n_4[2], n_4[6]);
+  connect_gates(n_4[3], n_4[7]);
+  connect_gates(n_4[4], n_4[7]);
+  connect_gates(n_4[5], n_4[6]);
+  connect_gates(n_4[6], n_4[8]);
+  connect_gates(n_4[7], n_4[8]);
+  connect_gates(n_4[8], n_4[9]);
+  connect_gates(n_4[8], n_4[9]);
 
   gate* output[1];
   output[0] = n_4[9];
 
-  network net = {n_4, 10, n_i_4, 4, output, 1};
+  network net = {n_4, 10, n_i_4, 4, output, 1, NULL};
 
   assertTrue("Goal 1", eval_network_fitness_vector(&net, goal1) == 1.0);
+  assertTrue("Goal 1 bitsliced", eval_network_fitness_bitsliced(&net, goal1) == 1.0);
+  assertBitslicedEq("Bitsliced 4", &net);
   cyclic = has_cycle(&net);
   assert(!cyclic);
-  for (i = 0; i < 10; i++) {
-    free(n_4[i]);
-  }
-  for (i = 0; i < 4; i++) {
-    free(n_i_4[i]);
-  }
-
-  printf("\n");
-}
-
-typedef struct {
-  int* DNA;
-  int DNA_length;
-  network* network;
-  double fitness;
-} circuit;
-
-uint32_t rand_range(sfmt_t* sfmt, uint32_t min, uint32_t max)
-{
-    int r;
-    const uint32_t range = max - min;
-    const uint32_t buckets = UINT32_MAX / range;
-    const uint32_t limit = buckets * range;
-
-    do
-    {
-        r = sfmt_genrand_uint32(sfmt);
-    } while (r >= limit);
-
-    return min + (r / buckets);
-}
-
-void random_dna(sfmt_t* sfmt, circuit* c) {
-  int i;
-  for (i = 0; i < c->DNA_length; i++) {
-    c->DNA[i] = rand_range(sfmt, 0, GATES + INPUTS);
-  }
-}
-
-void mutate(sfmt_t* sfmt, circuit* c) {
-  if (sfmt_genrand_real1(sfmt) < MUTATION) {
-    int mutation_gate = rand_range(sfmt, 0, DNA_LENGTH);
-    c->DNA[mutation_gate] = rand_range(sfmt, 0, GATES + INPUTS);
-  }
-}
-
-void create_circuit_network(circuit* c) {
-  c->network->num_gates = GATES;
-  c->network->num_inputs = INPUTS;
-  c->network->num_outputs = OUTPUTS;
-
-  gate** gates = (gate**)malloc(sizeof(gate*) * c->network->num_gates);
-  gate** inputs = (gate**)malloc(sizeof(gate*) * c->network->num_inputs);
-  gate** output = (gate**)malloc(sizeof(gate*) * c->network->num_outputs);
-
-  int i;
-  for (i = 0; i < c->network->num_gates; i++) {
-    gates[i] = (gate*)malloc(sizeof(gate));
-    make_gate(gates[i], nand_g, 2);
-  }
-  for (i = 0; i < c->network->num_inputs; i++) {
-    inputs[i] = (gate*)malloc(sizeof(gate));
-    make_gate(inputs[i], input_g, 1);
-  }
-
-  c->network->gates = gates;
-  c->network->inputs = inputs;
-  c->network->output = output;
-}
-
-void circuitize(circuit* c) {
-  int i, j;
-  for (i = 0; i < c->network->num_gates; i++) {
-    reset_gate(c->network->gates[i]);
-  }
-  for (i = 0; i < c->network->num_inputs; i++) {
-    reset_gate(c->network->inputs[i]);
-  }
-
-  int dna_pos = 0;
-  for (i = 0; i < GATES; i++) {
-    for (j = 0; j < INPUTS_PER_GATE; j++) {
-      uint16_t address = c->DNA[dna_pos++];
-      if (address >= INPUTS) {
-        connect(c->network->gates[address - INPUTS], c->network->gates[i]);
-      } else {
-        connect(c->network->inputs[address], c->network->gates[i]);
-      }
-    }
-  }
+  free_test_network(&net);
 
-  for (i = 0; i < OUTPUTS; i++) {
-    uint16_t address = c->DNA[dna_pos++];
-    if (address >= INPUTS) {
-      c->network->output[i] = c->network->gates[address - INPUTS];
-    } else {
-      c->network->output[i] = c->network->gates[address];
-    }
+  assertFitnessMatches("Bitsliced random", eval_network_fitness_bitsliced, TRIALS);
+  assertEvalMatches("Worklist random", eval_network_worklist, TRIALS);
+  assertEvalMatches("Levelized random", eval_network, TRIALS);
+  assertDnaMatches("DNA random", TRIALS);
+  assertIncrementalMatches("Incremental random", TRIALS);
+  assertNeutralMatches("Neutral random", TRIALS);
+  assertCanonicalMatches("Canonical random", TRIALS);
+  assertMemoMatches("Memo random", TRIALS);
+#if CODEGEN_TESTS
+  assertCompiledMatches("Compiled random", 100);
+#endif
+  assertPoolMatches("Pool random", 4, TRIALS);
+  assertSelectionMatches("Selection random", TRIALS);
+  assertRingFifo("Migration ring");
+  assertMigration("Island migration");
+  assertBulkUniform("Bulk uniform", TRIALS);
+  assertPhiloxKnownAnswers("Philox known answers");
+#if RNG == RNG_PHILOX
+  assertPhiloxStreams("Philox streams");
+#endif
+  for (i = 0; i < NUM_SIMD_ENGINES; i++) {
+    assertSimdMatches(&simd_engines[i], TRIALS);
   }
-}
+  assertSizedMatches("Sized kernels", TRIALS / 10);
 
-void make_circuit(circuit* c) {
-  c->network = (network*)malloc(sizeof(network));
-  c->DNA_length = DNA_LENGTH;
-  c->DNA = (int*)malloc(sizeof(int) * c->DNA_length);
-}
-
-void free_gate(gate* g) {
-  free(g->inputs);
-  free(g->outputs);
-  free(g->cache);
-}
-
-void free_network(network* n) {
-  int i;
-  for (i = 0; i < n->num_gates; i++) {
-    free_gate(n->gates[i]);
-    free(n->gates[i]);
-  }
-  for (i = 0; i < n->num_inputs; i++) {
-    free_gate(n->inputs[i]);
-    free(n->inputs[i]);
-  }
-  free(n->gates);
-  free(n->inputs);
-  free(n->output);
+  printf("\n");
 }
 
-int circuit_compare(const void* c1, const void* c2) {
-  if (((circuit*)c1)->fitness < ((circuit*)c2)->fitness) {
-    return -1;
-  } else if (((circuit*)c1)->fitness == ((circuit*)c2)->fitness) {
-    return 0;
-  } else {
+int main(int argc, char** argv) {
+  if (parse_arguments(argc, argv) != 0) {
     return 1;
   }
-}
-
-int time_to_perfect(sfmt_t* sfmt, void (**goal_fns)(int*, int*), int num_goals) {
-  printf("Running Experiment\n");
-  printf("==================\n");
-  printf("Iter LocalMax GlobalMax\n");
-  
-  circuit circuits[CIRCUITS];
-
-  int i, j;
-  for (i = 0; i < CIRCUITS; i++) {
-    make_circuit(&circuits[i]);
-    random_dna(sfmt, &circuits[i]);
-    create_circuit_network(&circuits[i]);
-  }
-
-  double max_fitness = 0.0;
-
-  int max_degree = -1;
-  int max_cyclic = -1;
-
-  int reached = -1;
-  
-  int current_goal = 0;
-  for (j = 0; ; j++) {
-    if (j != 0 && j % EPOCH == 0) {
-      current_goal++;
-      current_goal %= num_goals;
-    }
-    for (i = 0; i < CIRCUITS; i++) {
-      circuitize(&circuits[i]);
-      
-      circuits[i].fitness = eval_network_fitness_vector(circuits[i].network, goal_fns[current_goal]);
-      int deg = degree(circuits[i].network, 0);
-      if (deg > DEGREE) {
-        circuits[i].fitness -= DEGREE_PENALTY * (deg - DEGREE);
-      }
-
-      if (circuits[i].fitness > max_fitness) {
-        int cyclic = has_cycle(circuits[i].network);
-        max_fitness = circuits[i].fitness;
-        max_degree = deg;
-        max_cyclic = cyclic;
-      } else if (circuits[i].fitness == max_fitness) {
-        int cyclic = has_cycle(circuits[i].network);
-        if (max_cyclic && !cyclic) {
-          max_cyclic = cyclic;
-        }
-        if (deg < max_degree) {
-          max_degree = deg;
-          max_cyclic = cyclic;
-        }
-      }
-    }
-    qsort(circuits, CIRCUITS, sizeof(circuit), circuit_compare);
-    for (i = 0; i < CIRCUITS; i++) {
-      if (i < ELITE) {
-        memcpy(circuits[i].DNA, circuits[CIRCUITS - i - 1].DNA, circuits[i].DNA_length * sizeof(int));
-        mutate(sfmt, &circuits[i]);
-      } else if (i < CIRCUITS - ELITE - 1) {
-        mutate(sfmt, &circuits[i]);
-      }
-    }
-
-    if (reached == -1 && max_fitness == 1.0) {
-      reached = j;
-      break;
-    }
-    if ((j + 1) % UPDATE_INTERVAL == 0) {
-      printf("%d: %f %f (effective gates: %d; %s)\n", j + 1, circuits[CIRCUITS-1].fitness, max_fitness, max_degree, (max_cyclic ? "cyclic" : "acyclic"));
-    }
-  }
-
-  for (i = 0; i < CIRCUITS; i++) {
-    free(circuits[i].DNA);
-    free_network(circuits[i].network);
-    free(circuits[i].network);
-  }
-
-  return reached;
-}
-
-int main(int argc, char** argv) {
+  select_sized_kernels();
+  init_gate_functions();
   RunTests();
 
   sfmt_t sfmt;
-  sfmt_init_gen_rand(&sfmt, SEED);
-
-  int num_goals;
+  sfmt_init_gen_rand(&sfmt, params.seed);
 
-  // GOAL FUNCTIONS: uncomment a line
-  // to change goal functionality.
-  //
-  // ----single goal----
-  // void (*goal_fns[1])(int*, int*) = {goal1}; num_goals = 1;
-  // ----modularly varying goals----
-  void (*goal_fns[2])(int*, int*) = {goal1, goal2}; num_goals = 2;
+  const goal_set* goals = &goal_sets[params.goals];
+  int num_goals = goals->num_goals;
+  void (*goal_fns[MAX_GOALS])(int*, int*);
+  memcpy(goal_fns, goals->fns, sizeof(goal_fns));
 
 
+#if FARM
+  run_farm(goal_fns, num_goals);
+#else
   int i;
   int total = 0;
-  for (i = 0; i < EXPERIMENTS; i++) {
-    int reached = time_to_perfect(&sfmt, goal_fns, num_goals);
+  for (i = 0; i < params.experiments; i++) {
+    int reached = time_to_perfect(&sfmt, i, goal_fns, num_goals, stdout);
     total += reached;
     printf("---------------\nEXPERIMENT #%d: %d iterations (avg: %0.2f)\n\n", i+1, reached, (double)total / (i+1));
   }
+#endif
 
   return 0;
 }
\ No newline at end of file